@@ -1,3 +1,9 @@
 glslc ../resources/shaders/source/post-process-shader.vert -o ../resources/shaders/generated/post-process-vert.spv
 glslc ../resources/shaders/source/post-process-shader.frag -o ../resources/shaders/generated/post-process-frag.spv
 glslc ../resources/shaders/source/mandelbrot.comp -o ../resources/shaders/generated/mandelbrot.spv
+glslc -DUSE_FP16 ../resources/shaders/source/mandelbrot.comp -o ../resources/shaders/generated/mandelbrot-fp16.spv
+glslc ../resources/shaders/source/mandelbrot-cone.comp -o ../resources/shaders/generated/mandelbrot-cone.spv
+glslc ../resources/shaders/source/checkerboard-resolve.comp -o ../resources/shaders/generated/checkerboard-resolve.spv
+glslc ../resources/shaders/source/tile-classify.comp -o ../resources/shaders/generated/tile-classify.spv
+glslc ../resources/shaders/source/sdf-bake.comp -o ../resources/shaders/generated/sdf-bake.spv
+glslc ../resources/shaders/source/mandelbrot-batch.comp -o ../resources/shaders/generated/mandelbrot-batch.spv
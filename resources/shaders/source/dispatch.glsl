@@ -0,0 +1,16 @@
+// Region a compute kernel covers, pushed by ComputeModel::dispatch.
+// Dispatches are rounded up to whole workgroups, invocations outside the region must not write anything.
+
+// A stage has one push constant block, frame-uniforms.glsl declares it with the extent first when included.
+#ifdef FRAME_CONSTANTS
+#define DISPATCH_EXTENT frame.extent
+#else
+layout(push_constant) uniform DispatchBounds {
+    uvec3 extent;
+} dispatchBounds;
+#define DISPATCH_EXTENT dispatchBounds.extent
+#endif
+
+bool isOutOfBounds(uvec3 id) {
+    return any(greaterThanEqual(id, DISPATCH_EXTENT));
+}
@@ -0,0 +1,24 @@
+// Per frame parameters of the mandelbrot kernels, FrameConstants in main.cpp. They are push constants
+// behind the DispatchBounds of dispatch.glsl, which has to be included after this file.
+#define FRAME_CONSTANTS
+
+layout(push_constant) uniform FrameConstants {
+    // DispatchBounds, pushed by ComputeModel::dispatch.
+    uvec3 extent;
+    // Pushed by ComputeMaterial::bind.
+    layout(offset = 16) vec3 camPos;
+    float time;
+    // Position of this image inside the full output, non-zero when rendering tiles.
+    ivec2 tileOffset;
+    // Size of the full output the uv is computed against.
+    ivec2 outputExtent;
+    // Camera and output size of the previous frame, whose hit distances are in the history.
+    vec3 prevCamPos;
+    // Zero when there is no previous frame to build on, on the first frame or while tiling.
+    int historyValid;
+    ivec2 prevOutputExtent;
+    // Layer of the history written this frame, the other one holds the previous frame.
+    int historyLayer;
+    // Pixels with an even x + y + checkerboardParity are shaded this frame when checkerboarding.
+    int checkerboardParity;
+} frame;
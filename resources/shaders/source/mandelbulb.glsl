@@ -0,0 +1,157 @@
+// Mandelbulb scene shared by the compute kernels.
+// Kernels set power with getPower before calling shade.
+// Constant ids 0 and 1 are the workgroup size, set by ComputeMaterial.
+
+layout(constant_id = 2) const int MAX_STEPS = 100;
+layout(constant_id = 3) const int FRACTAL_ITERATIONS = 20;
+layout(constant_id = 4) const float DISTANCE_THRESH = .01;
+
+#define MAX_DISTANCE 100.
+
+// Centre of the mandelbulb in scene space. None of it lies further than MANDELBULB_RADIUS from
+// there, past that the iteration escapes right away.
+#define MANDELBULB_CENTER vec3(0, 1, 3)
+#define MANDELBULB_RADIUS 2.
+
+// Type of the lighting and colour math. Kernels built with USE_FP16 run it in half precision,
+// which needs the shaderFloat16 feature. Distances and positions always stay in full precision.
+#ifdef USE_FP16
+#define shading_float float16_t
+#define shading_vec3 f16vec3
+#else
+#define shading_float float
+#define shading_vec3 vec3
+#endif
+
+// Distance ray marching and shadows step through empty space with. Kernels can define a cheaper
+// one before including this file, it may underestimate but never overestimate.
+#ifndef MARCH_DIST
+#define MARCH_DIST getDist
+#endif
+
+// Exponent of the mandelbulb formula.
+float power;
+
+float getPower(float time) {
+    return 10 * sin(time/10);
+}
+
+float getDistMandelbulb(vec3 pos) {
+    float Power = power;
+	vec3 z = pos;
+	float dr = 1.0;
+	float r = 0.0;
+	for (int i = 0; i < FRACTAL_ITERATIONS ; i++) {
+		r = length(z);
+		if (r>2) break;
+		
+		// convert to polar coordinates
+		float theta = acos(z.z/r);
+		float phi = atan(z.y,z.x);
+		dr =  pow( r, Power-1.0)*Power*dr + 1.0;
+		
+		// scale and rotate the point
+		float zr = pow( r,Power);
+		theta = theta*Power;
+		phi = phi*Power;
+		
+		// convert back to cartesian coordinates
+		z = zr*vec3(sin(theta)*cos(phi), sin(phi)*sin(theta), cos(theta));
+		z+=pos;
+	}
+	return 0.5*log(r)*r/dr;
+}
+
+//Get distanse from point p to the scene.
+float getDist(vec3 p) {
+    float mandelbulbDist = getDistMandelbulb(p - MANDELBULB_CENTER);
+    return mandelbulbDist;
+}
+
+// Lower bound of the distance to the mandelbulb. Outside the bounding sphere getDist
+// overestimates far away, the sphere itself is a safe bound there.
+float getDistBounded(vec3 p) {
+    float sphereDist = length(p - MANDELBULB_CENTER) - MANDELBULB_RADIUS;
+    return sphereDist > 0. ? sphereDist : getDist(p);
+}
+
+
+// Sphere traces from start along the ray, start must be in front of the first surface.
+float rayMarch(vec3 ro, vec3 rd, float start) {
+    float dO = start;
+    for(int i = 0; i< MAX_STEPS; i++){
+        vec3 p = ro + rd*dO;
+        float ds = MARCH_DIST(p);
+        dO += ds;
+        if (dO > MAX_DISTANCE || ds < DISTANCE_THRESH) {
+            break;
+        }
+    }
+    return dO;
+}
+
+shading_vec3 getNormal(vec3 p) {
+    float d = getDist(p);
+    vec2 e = vec2(.01, 0);
+    // The differences cancel most of the bits of the distances, so only their result is narrowed.
+    vec3 n = d - vec3(
+        getDist(p - e.xyy),
+        getDist(p - e.yxy),
+        getDist(p - e.yyx)
+    );
+    return normalize(shading_vec3(n));
+}
+
+float shadow( in vec3 ro, in vec3 rd, float k)
+{
+    float res = 1.0;
+    for( float t=0; t<MAX_STEPS; )
+    {
+        float h = MARCH_DIST(ro + rd*t);
+        if( h<0.001 )
+            return 0.0;
+        res = min( res, k*h/t );
+        t += h;
+    }
+    return res;
+}
+
+shading_float getLight(vec3 p) {
+    vec3 lightPos = vec3(0,5,2);
+    //lightPos.xz += vec2(sin(time), cos(time));
+    // Missed rays end far enough away to overflow a half precision length.
+    shading_vec3 l = shading_vec3(normalize(lightPos - p));
+    shading_vec3 n = getNormal(p);
+
+    shading_float dif = clamp(dot(n,l), shading_float(0), shading_float(1));
+    return dif;
+}
+
+// Position of the camera at camPos in scene space.
+vec3 getRayOrigin(vec3 camPos) {
+    return camPos.zxy * vec3(-1, 1, 1);
+}
+
+// The camera doesn't rotate, uv is where the ray crosses the z = 1 plane in front of it.
+vec3 getRayDirection(vec2 uv) {
+    return normalize(vec3(uv.xy,1));
+}
+
+// Colour of the ray from ro along rd that hits the scene at distance d.
+vec3 shadeHit(vec3 ro, vec3 rd, float d) {
+    // Point of intersection
+    vec3 p = ro + rd * d;
+
+    shading_float dif = getLight(p);
+    
+    return vec3(shading_vec3(dif));
+}
+
+// Colour seen through uv from the camera at camPos.
+vec3 shade(vec3 camPos, vec2 uv) {
+    vec3 ro = getRayOrigin(camPos);
+    vec3 rd = getRayDirection(uv);
+    // Distance to the intersection with the scene.
+    float d = rayMarch(ro, rd, 0.);
+    return shadeHit(ro, rd, d);
+}
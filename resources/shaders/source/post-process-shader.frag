@@ -3,12 +3,22 @@
 
 layout(location = 0) in vec2 fragTexCoord;
 
+// Pushed every frame, PostProcessParams in main.cpp.
+layout(push_constant) uniform PostProcessParams {
+    // Part of the texture the compute pass rendered this frame, in uv units.
+    vec2 renderScale;
+} params;
+
 layout(binding = 0) uniform sampler2D texSampler;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    vec4 fragCol = texture(texSampler, fragTexCoord);
+    // Bilinear upscale of the rendered region. Taps stay half a texel inside it,
+    // the texels past it are left over from frames rendered at another scale.
+    vec2 halfTexel = 0.5 / vec2(textureSize(texSampler, 0));
+    vec2 uv = clamp(fragTexCoord * params.renderScale, halfTexel, params.renderScale - halfTexel);
+    vec4 fragCol = texture(texSampler, uv);
     float gamma = 2.2;
     outColor = vec4(pow(fragCol.rgb, vec3(1.0/gamma)), 1.0);
 }
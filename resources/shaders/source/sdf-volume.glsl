@@ -0,0 +1,24 @@
+// Distances of the mandelbulb baked by sdf-bake.comp into a volume over the cube around
+// MANDELBULB_CENTER, used to cross empty space without evaluating the fractal.
+// Needs a sampler3D sdfVolume declared by the kernel.
+
+layout(constant_id = 9) const bool USE_SDF_VOLUME = false;
+
+// Baked distances are lowered by a voxel diagonal, so trilinear filtering never overestimates.
+// Below a few voxels they are too coarse to be useful and the analytic distance takes over.
+float getDistCoarse(vec3 p) {
+    if (USE_SDF_VOLUME) {
+        vec3 size = vec3(textureSize(sdfVolume, 0));
+        vec3 uvw = (p - MANDELBULB_CENTER) / (2. * MANDELBULB_RADIUS) + 0.5;
+        // Filtering past the outer voxel centres would wrap around to the other side.
+        vec3 halfTexel = 0.5 / size;
+        if (all(greaterThanEqual(uvw, halfTexel)) && all(lessThanEqual(uvw, 1. - halfTexel))) {
+            float d = texture(sdfVolume, uvw).r;
+            float voxelDiagonal = length(2. * MANDELBULB_RADIUS / size);
+            if (d > 2. * voxelDiagonal) {
+                return d;
+            }
+        }
+    }
+    return getDist(p);
+}
@@ -1,13 +1,24 @@
 #include "../utils/vulkan.h"
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
 #include "VulkanApplicationContext.h"
 
-VulkanApplicationContext::VulkanApplicationContext() {
-    initWindow();
+VulkanApplicationContext::VulkanApplicationContext() {}
+
+void VulkanApplicationContext::init(bool headless, bool asyncCompute) {
+    this->headless = headless;
+    this->asyncCompute = asyncCompute;
+    if (!headless) {
+        initWindow();
+    }
     createInstance();
-    createSurface();
+    if (!headless) {
+        createSurface();
+    }
     pickPhysicalDevice();
     createLogicalDevice();
     createAllocator();
@@ -16,14 +27,35 @@ VulkanApplicationContext::VulkanApplicationContext() {
 }
 
 VulkanApplicationContext::~VulkanApplicationContext() {
+    if (instance == VK_NULL_HANDLE) {
+        return;
+    }
     std::cout << "Destroying context" << "\n";
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    vmaDestroyAllocator(allocator);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (device != VK_NULL_HANDLE) {
+        if (pipelineCache != VK_NULL_HANDLE) {
+            savePipelineCache();
+            vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        }
+        if (computeCommandPool != commandPool) {
+            vkDestroyCommandPool(device, computeCommandPool, nullptr);
+        }
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vmaDestroyAllocator(allocator);
+        vkDestroyDevice(device, nullptr);
+    }
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
 
-    vkDestroyDevice(device, nullptr);
     vkDestroyInstance(instance, nullptr);
-    glfwDestroyWindow(window);
+    if (window != nullptr) {
+        glfwDestroyWindow(window);
+    }
+}
+
+bool VulkanApplicationContext::hasDedicatedComputeQueue() const {
+    return queueFamilyIndices.computeFamily.has_value() &&
+           queueFamilyIndices.computeFamily != queueFamilyIndices.graphicsFamily;
 }
 
 SwapChainSupportDetails VulkanApplicationContext::querySwapChainSupport() const {
@@ -71,21 +103,33 @@ QueueFamilyIndices VulkanApplicationContext::findQueueFamilies(VkPhysicalDevice
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        // Without a dedicated compute family the compute dispatch and the post-process draw
+        // are recorded into the same command buffer.
+        if (!indices.graphicsFamily.has_value() &&
+            (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
             indices.graphicsFamily = i;
         }
-        VkBool32 presentSupport = false;
-        // It's likely that graphics and presentation are handled by the same queue family.
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport) {
-            indices.presentFamily = i;
+        // Compute-only families are the ones that run alongside graphics work.
+        if (asyncCompute && !indices.computeFamily.has_value() &&
+            (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.computeFamily = i;
         }
-        if (indices.isComplete()) {
-            break;
+        if (!headless && !indices.presentFamily.has_value()) {
+            VkBool32 presentSupport = false;
+            // It's likely that graphics and presentation are handled by the same queue family.
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (presentSupport) {
+                indices.presentFamily = i;
+            }
         }
         i++;
     }
 
+    // Single queue fallback, e.g. lavapipe only has one family.
+    if (!indices.computeFamily.has_value()) {
+        indices.computeFamily = indices.graphicsFamily;
+    }
+
     return indices;
 }
 
@@ -170,12 +214,15 @@ void VulkanApplicationContext::createInstance() {
         std::cout << '\t' << extension.extensionName << '\n';
     }
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<std::string> requiredExtensions;
+    // Headless mode never initializes glfw, so there are no surface extensions to ask for.
+    if (!headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
 
-    std::vector<std::string> requiredExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        requiredExtensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     requiredExtensions.push_back("VK_KHR_get_physical_device_properties2");
     std::vector<char*> pointerVec(requiredExtensions.size());
     for(unsigned i = 0; i < requiredExtensions.size(); ++i)
@@ -205,6 +252,28 @@ VkSampleCountFlagBits VulkanApplicationContext::getMaxUsableSampleCount() {
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
+std::vector<const char*> VulkanApplicationContext::getRequiredDeviceExtensions() const {
+    if (headless) {
+        return {};
+    }
+    return deviceExtensions;
+}
+
+bool VulkanApplicationContext::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool VulkanApplicationContext::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -212,7 +281,8 @@ bool VulkanApplicationContext::checkDeviceExtensionSupport(VkPhysicalDevice devi
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::vector<const char*> required = getRequiredDeviceExtensions();
+    std::set<std::string> requiredExtensions(required.begin(), required.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -223,12 +293,13 @@ bool VulkanApplicationContext::checkDeviceExtensionSupport(VkPhysicalDevice devi
 
 bool VulkanApplicationContext::isDeviceSuitable(VkPhysicalDevice device, QueueFamilyIndices indices) {
     bool extensionsSupported = checkDeviceExtensionSupport(device);
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // There is no swapchain to create in headless mode.
+    bool swapChainAdequate = headless;
+    if (extensionsSupported && !headless) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
-    return indices.isComplete() && extensionsSupported && swapChainAdequate;
+    return indices.isComplete(headless) && extensionsSupported && swapChainAdequate;
 }
 
 void VulkanApplicationContext::pickPhysicalDevice() {
@@ -261,9 +332,11 @@ void VulkanApplicationContext::pickPhysicalDevice() {
 
 void VulkanApplicationContext::createLogicalDevice() {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies =
-                        { queueFamilyIndices.graphicsFamily.value(),
-                            queueFamilyIndices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily.value(),
+                                               queueFamilyIndices.computeFamily.value() };
+    if (!headless) {
+        uniqueQueueFamilies.insert(queueFamilyIndices.presentFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -275,8 +348,31 @@ void VulkanApplicationContext::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.sampleRateShading = VK_TRUE;
+    // Storage images in formats like r16f, used by the baked distance volume.
+    deviceFeatures.shaderStorageImageExtendedFormats = supportedFeatures.shaderStorageImageExtendedFormats;
+    enabledFeatures = deviceFeatures;
+
+    // Half precision arithmetic is an extension on Vulkan 1.0, so its feature can only be queried
+    // through the pNext chain of VK_KHR_get_physical_device_properties2.
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16Int8Features{};
+    float16Int8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+    auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+    if (getPhysicalDeviceFeatures2 != nullptr &&
+        isDeviceExtensionAvailable(physicalDevice, VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &float16Int8Features;
+        getPhysicalDeviceFeatures2(physicalDevice, &features2);
+    }
+    shaderFloat16 = float16Int8Features.shaderFloat16 == VK_TRUE;
+    // The kernels have no use for 8 bit integers.
+    float16Int8Features.shaderInt8 = VK_FALSE;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -284,8 +380,16 @@ void VulkanApplicationContext::createLogicalDevice() {
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
     // Device-specific extensions.
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    std::vector<const char*> extensions = getRequiredDeviceExtensions();
+    if (isDeviceExtensionAvailable(physicalDevice, portabilitySubsetExtension)) {
+        extensions.push_back(portabilitySubsetExtension);
+    }
+    if (shaderFloat16) {
+        extensions.push_back(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+        createInfo.pNext = &float16Int8Features;
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
     // Same validation layers as for instance. Needed for backwards compatability with previous vulkan versions.
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -299,7 +403,10 @@ void VulkanApplicationContext::createLogicalDevice() {
     }
 
     vkGetDeviceQueue(device, queueFamilyIndices.graphicsFamily.value(), 0, &graphicsQueue);
-    vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, queueFamilyIndices.computeFamily.value(), 0, &computeQueue);
+    if (!headless) {
+        vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
+    }
 }
 
 void VulkanApplicationContext::createAllocator() {
@@ -318,13 +425,27 @@ void VulkanApplicationContext::createCommandPool() {
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0; // Optional
+    // Every frame re-records the command buffers of its swapchain image.
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    if (!hasDedicatedComputeQueue()) {
+        computeCommandPool = commandPool;
+        return;
+    }
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool!");
+    }
 }
 
 void VulkanApplicationContext::initSwapchainImageCount() {
+    if (headless) {
+        swapChainImageCount = HEADLESS_IMAGE_COUNT;
+        return;
+    }
     SwapChainSupportDetails swapChainSupport = VulkanGlobal::context.querySwapChainSupport();
     swapChainImageCount = swapChainSupport.capabilities.minImageCount + 1;
     if (swapChainSupport.capabilities.maxImageCount > 0 &&
@@ -332,3 +453,119 @@ void VulkanApplicationContext::initSwapchainImageCount() {
             swapChainImageCount = swapChainSupport.capabilities.maxImageCount;
     }
 }
+
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x4350434d; // "MCPC"
+
+static uint64_t hashPipelineCacheData(const char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void VulkanApplicationContext::createPipelineCache(const std::string& path) {
+    pipelineCachePath = path;
+    std::vector<char> initialData;
+    if (!path.empty()) {
+        initialData = loadPipelineCacheData(path);
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+// Returns the cached data, or nothing when the file is missing or was written for another device or driver.
+std::vector<char> VulkanApplicationContext::loadPipelineCacheData(const std::string& path) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    PipelineCacheFileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (!file || header.magic != PIPELINE_CACHE_MAGIC ||
+        header.vendorID != properties.vendorID ||
+        header.deviceID != properties.deviceID ||
+        header.driverVersion != properties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cout << "Ignoring pipeline cache " << path << ", it was written for another device or driver\n";
+        return {};
+    }
+
+    // Check the size against the file before allocating, the header itself may be garbage.
+    std::streampos dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    if (static_cast<uint64_t>(file.tellg() - dataStart) != header.dataSize) {
+        std::cout << "Ignoring corrupted pipeline cache " << path << "\n";
+        return {};
+    }
+    file.seekg(dataStart);
+
+    std::vector<char> data(header.dataSize);
+    file.read(data.data(), data.size());
+    if (!file || hashPipelineCacheData(data.data(), data.size()) != header.dataHash) {
+        std::cout << "Ignoring corrupted pipeline cache " << path << "\n";
+        return {};
+    }
+    std::cout << "Loaded " << data.size() << " bytes of pipeline cache from " << path << "\n";
+    return data;
+}
+
+// Writes to a temporary file and renames it over the old cache, so a crash mid-write
+// never leaves a truncated cache behind.
+void VulkanApplicationContext::savePipelineCache() const {
+    if (pipelineCachePath.empty()) {
+        return;
+    }
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS) {
+        std::cerr << "failed to get pipeline cache size!\n";
+        return;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+        std::cerr << "failed to get pipeline cache data!\n";
+        return;
+    }
+    data.resize(dataSize);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader header{};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = hashPipelineCacheData(data.data(), data.size());
+
+    // Runs from the destructor, so failures are reported instead of thrown.
+    std::string tmpPath = pipelineCachePath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+        if (!file) {
+            std::cerr << "failed to write pipeline cache!\n";
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), pipelineCachePath.c_str()) != 0) {
+        std::cerr << "failed to replace pipeline cache!\n";
+        std::remove(tmpPath.c_str());
+    }
+}
@@ -11,9 +11,13 @@ const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
 
+// Required only when presenting to a window.
 const std::vector<const char*> deviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_KHR_portability_subset"
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
+
+// Must be enabled whenever the device exposes it (MoltenVK), but most drivers don't.
+const char* const portabilitySubsetExtension = "VK_KHR_portability_subset";
 #ifdef NDEBUG
     const bool enableValidationLayers = true;
 #else
@@ -23,15 +27,34 @@ const std::vector<const char*> deviceExtensions = {
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// Number of offscreen images standing in for the swapchain in headless mode.
+const uint32_t HEADLESS_IMAGE_COUNT = 3;
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Family without graphics support that can run compute next to the graphics queue, if the device has one.
+    std::optional<uint32_t> computeFamily;
 
-    bool isComplete() {
-        return graphicsFamily.has_value() && presentFamily.has_value();
+    // Without a surface there is nothing to present to, so only the graphics family is needed.
+    bool isComplete(bool headless) {
+        return graphicsFamily.has_value() && (headless || presentFamily.has_value());
     }
 };
 
+// Written in front of the driver's cache data. Vulkan's own cache header has no driver version,
+// and a new driver may reject or, worse, misread an old cache.
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    // FNV-1a of the data, catches truncated or corrupted files.
+    uint64_t dataHash;
+};
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -40,18 +63,30 @@ struct SwapChainSupportDetails {
 
 class VulkanApplicationContext {
     public:
-        GLFWwindow* window;
-        VkInstance instance;
-        VkPhysicalDevice physicalDevice;
+        // Headless contexts have no window, surface or swapchain.
+        bool headless = false;
+        bool asyncCompute = true;
+        GLFWwindow* window = nullptr;
+        VkInstance instance = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         // Logical device.
-        VkDevice device;
-        VkSurfaceKHR surface;
+        VkDevice device = VK_NULL_HANDLE;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
         QueueFamilyIndices queueFamilyIndices;
-        VkQueue graphicsQueue;
-        VkQueue presentQueue;
-        VkCommandPool commandPool;
-        VmaAllocator allocator;
+        VkQueue graphicsQueue = VK_NULL_HANDLE;
+        VkQueue presentQueue = VK_NULL_HANDLE;
+        // Same as graphicsQueue and commandPool unless there is a dedicated compute family.
+        VkQueue computeQueue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+        // Used for every pipeline, persisted across runs by createPipelineCache.
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        VmaAllocator allocator = VK_NULL_HANDLE;
         VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+        // Features the device was created with, optional ones only when the device has them.
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        // Set when shaders can do arithmetic on 16 bit floats, VK_KHR_shader_float16_int8 is enabled then.
+        bool shaderFloat16 = false;
 
         uint32_t swapChainImageCount;
         
@@ -59,6 +94,19 @@ class VulkanApplicationContext {
 
         ~VulkanApplicationContext() ;
 
+        // Creates the window (unless headless), instance, device, allocator and command pool.
+        // Called from main once the command line is known, instead of at static-init time.
+        // asyncCompute picks a dedicated compute queue family when the device has one.
+        void init(bool headless, bool asyncCompute = true);
+
+        // True when compute work is submitted to its own queue family and resources shared
+        // with graphics need queue family ownership transfers.
+        bool hasDedicatedComputeQueue() const;
+
+        // Creates the pipeline cache, seeded from path when the file was written for this device and driver.
+        // The cache is saved back to path on destruction, an empty path keeps it in memory only.
+        void createPipelineCache(const std::string& path);
+
         SwapChainSupportDetails querySwapChainSupport() const;
 
         VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
@@ -82,6 +130,10 @@ class VulkanApplicationContext {
 
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+        bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
+
+        std::vector<const char*> getRequiredDeviceExtensions() const;
+
         bool isDeviceSuitable(VkPhysicalDevice device, QueueFamilyIndices indices);
 
         void pickPhysicalDevice();
@@ -94,8 +146,14 @@ class VulkanApplicationContext {
 
         void initSwapchainImageCount();
 
+        std::vector<char> loadPipelineCacheData(const std::string& path) const;
+
+        void savePipelineCache() const;
+
+        std::string pipelineCachePath;
+
 };
 
 namespace VulkanGlobal {
-    extern const VulkanApplicationContext context;
+    extern VulkanApplicationContext context;
 }
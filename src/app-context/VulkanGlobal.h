@@ -1,6 +1,10 @@
 namespace VulkanGlobal {
     // Application context - manages device, surface, queues and command pool.
-    const VulkanApplicationContext context{};
+    // Both are initialized from main once the command line has been parsed.
+    VulkanApplicationContext context{};
 
-    const VulkanSwapchain swapchainContext{};
+    VulkanSwapchain swapchainContext{};
+
+    // Declared after the context, so it is destroyed while the device still exists.
+    mcvkp::LayoutCache layoutCache{};
 }
\ No newline at end of file
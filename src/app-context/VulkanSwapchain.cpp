@@ -3,12 +3,25 @@
 #include <vector>
 #include <iostream>
 
-VulkanSwapchain::VulkanSwapchain() {
-    createSwapChain();
-    createImageViews();
+VulkanSwapchain::VulkanSwapchain() {}
+
+void VulkanSwapchain::init(VkExtent2D offscreenExtent) {
+    if (VulkanGlobal::context.headless) {
+        createOffscreenImages(offscreenExtent);
+        // Leave the image ready to be copied out instead of presented.
+        swapChainImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    } else {
+        createSwapChain();
+        createImageViews();
+        swapChainImageLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
 }
 
 VulkanSwapchain::~VulkanSwapchain() {
+    // Offscreen images own their views and are released with offscreenImages.
+    if (swapChain == VK_NULL_HANDLE) {
+        return;
+    }
     std::cout << "Destroying swapchain" << "\n";
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         vkDestroyImageView(VulkanGlobal::context.device, swapChainImageViews[i], nullptr);
@@ -121,4 +134,32 @@ void VulkanSwapchain::createImageViews() {
                                             VK_IMAGE_ASPECT_COLOR_BIT,
                                             mipLevels);
     }
-}
\ No newline at end of file
+}
+
+void VulkanSwapchain::createOffscreenImages(VkExtent2D extent) {
+    swapChainImageFormat = VulkanGlobal::context.findSupportedFormat(
+        {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+    swapChainExtent = extent;
+
+    uint32_t imageCount = VulkanGlobal::context.swapChainImageCount;
+    std::cout << "Offscreen image count: " << imageCount << "\n";
+
+    for (size_t i = 0; i < imageCount; i++) {
+        auto image = std::make_shared<mcvkp::Image>();
+        mcvkp::ImageUtils::createImage(swapChainExtent.width,
+                                       swapChainExtent.height,
+                                       1,
+                                       VK_SAMPLE_COUNT_1_BIT,
+                                       swapChainImageFormat,
+                                       VK_IMAGE_TILING_OPTIMAL,
+                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                       VK_IMAGE_ASPECT_COLOR_BIT,
+                                       VMA_MEMORY_USAGE_GPU_ONLY,
+                                       image);
+        offscreenImages.push_back(image);
+        swapChainImages.push_back(image->image);
+        swapChainImageViews.push_back(image->imageView);
+    }
+}
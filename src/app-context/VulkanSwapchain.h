@@ -2,20 +2,28 @@
 
 #include "../utils/vulkan.h"
 #include <vector>
+#include <memory>
 #include "VulkanApplicationContext.h"
 #include "../memory/Image.h"
 
 class VulkanSwapchain {
     public:
-        VkSwapchainKHR swapChain;
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
         std::vector<VkImage> swapChainImages;
         VkFormat swapChainImageFormat;
         VkExtent2D swapChainExtent;
         std::vector<VkImageView> swapChainImageViews;
+        // Layout the final render pass leaves swapchain images in.
+        VkImageLayout swapChainImageLayout;
+        // In headless mode these ordinary images take the place of the swapchain images.
+        std::vector<std::shared_ptr<mcvkp::Image> > offscreenImages;
         
         VulkanSwapchain();
         ~VulkanSwapchain();
 
+        // Creates the swapchain, or offscreen images of the given extent if the context is headless.
+        void init(VkExtent2D offscreenExtent = {WIDTH, HEIGHT});
+
     private:
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
@@ -26,8 +34,10 @@ class VulkanSwapchain {
         void createSwapChain();
 
         void createImageViews();
+
+        void createOffscreenImages(VkExtent2D extent);
 };
 
 namespace VulkanGlobal {
-    extern const VulkanSwapchain swapchainContext;
+    extern VulkanSwapchain swapchainContext;
 }
\ No newline at end of file
@@ -4,9 +4,18 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <optional>
+#include <cmath>
 #include "utils/vulkan.h"
 #include "app-context/VulkanApplicationContext.h"
 #include "app-context/VulkanSwapchain.h"
+#include "render-context/LayoutCache.h"
 #include "app-context/VulkanGlobal.h"
 #include "utils/RootDir.h"
 #include "utils/glm.h"
@@ -17,8 +26,22 @@
 #include "render-context/ForwardRenderPass.h"
 #include "render-context/FlatRenderPass.h"
 #include "render-context/RenderSystem.h"
+#include "render-context/BatchRenderer.h"
+#include "render-context/GpuTimer.h"
+#include "render-context/WorkgroupAutotuner.h"
+#include "render-context/ResolutionGovernor.h"
+#include "render-context/ShaderCompiler.h"
+#include "render-context/RenderGraph.h"
+#include "render-context/ParallelRecorder.h"
 #include "scene/ComputeMaterial.h"
 #include "scene/ComputeModel.h"
+#include "memory/ReadbackRing.h"
+#include "memory/UniformArena.h"
+#include "memory/TransientImagePool.h"
+#include "utils/MappedFile.h"
+#include "utils/FileWatcher.h"
+#include "utils/FrameStatistics.h"
+#include "utils/readfile.h"
 
 // TODO: Organize includes!
 
@@ -32,29 +55,460 @@ float deltaTime = 0.0f; // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 Camera camera(glm::vec3(0.0f, 0.0f, 0.0f));
 
-struct UniformBufferObject
+// Per frame parameters of the mandelbrot kernels, pushed behind their DispatchBounds. FrameConstants in frame-uniforms.glsl.
+struct FrameConstants
 {
     glm::vec3 camPosition;
     float time;
+    glm::ivec2 tileOffset;
+    glm::ivec2 outputExtent;
+    glm::vec3 prevCamPosition;
+    int32_t historyValid;
+    glm::ivec2 prevOutputExtent;
+    int32_t historyLayer;
+    int32_t checkerboardParity;
 };
 
+struct PostProcessParams
+{
+    glm::vec2 renderScale;
+};
+
+struct AppSettings
+{
+    // Render without a window, surface or swapchain.
+    bool headless = false;
+    // Number of frames to render before exiting, 0 renders until the window is closed.
+    uint32_t frameCount = 0;
+    // Size of the offscreen images in headless mode.
+    VkExtent2D offscreenExtent = {WIDTH, HEIGHT};
+    // Number of staging buffers the compute target is read back through, 0 disables readback.
+    uint32_t readbackSlots = 0;
+    // When set, read back frames are written there as PPM files.
+    std::string outputDirectory;
+    // Size of the image rendered tile by tile, zero when not tiling.
+    VkExtent2D tiledExtent = {0, 0};
+    uint32_t tileSize = 1024;
+    // Raw RGBA8 file the tiles are streamed into.
+    std::string outputFile;
+    // Tiles all have to see the same fractal, so tiled rendering doesn't advance time.
+    float fixedTime = 10.0f;
+    // Text file with one "x y z time" view per line, rendered in batches instead of running the loop.
+    std::string sweepFile;
+    // Number of views rendered per submission in a sweep.
+    uint32_t batchSize = 32;
+    // Render with a fixed timestep and report frame time percentiles, frameCount frames are measured.
+    bool benchmark = false;
+    // Frames rendered before measuring starts, to get past pipeline and cache warm-up.
+    uint32_t warmupFrames = 30;
+    // Seconds the scene time advances per benchmark frame.
+    float timestep = 1.0f / 60.0f;
+    std::string reportFile = "benchmark.json";
+    // Use a dedicated compute queue family when the device has one.
+    bool asyncCompute = true;
+    // Pipeline cache kept between runs, empty disables it.
+    std::string pipelineCachePath = "pipeline-cache.bin";
+    // Compiled compute kernels kept between runs, used when the build has shaderc.
+    std::string shaderCachePath = "shader-cache";
+    // Load the kernels compile.sh generated even when they could be compiled at runtime.
+    bool prebuiltShaders = false;
+    // Rebuild the compute kernels whenever a file in shaders/source changes.
+    bool hotReload = false;
+    // Ray marching quality, baked into the compute pipeline as specialization constants.
+    int32_t maxSteps = 100;
+    int32_t fractalIterations = 20;
+    float distanceThreshold = 0.01f;
+    // Time every supported workgroup size instead of trusting the cached one.
+    bool autotune = false;
+    std::string autotuneCachePath = "workgroup-cache.txt";
+    // GPU time budget per frame the render scale is adjusted to, 0 always renders at full resolution.
+    float targetFrameMilliseconds = 0;
+    // Lowest render scale the governor may pick, per axis.
+    float minRenderScale = 0.5f;
+    // Start rays from the reprojected hit distances of the previous frame.
+    bool reprojection = true;
+    // March one cone per tile at low resolution first and start the rays of the tile where it hit.
+    bool conePrepass = false;
+    // Shade half the pixels per frame in an alternating checkerboard and reconstruct the rest.
+    bool checkerboard = false;
+    // Voxels per side of the baked distance volume, 0 marches the analytic distance only.
+    uint32_t sdfVolumeSize = 0;
+    // Change of the mandelbulb power that makes the volume stale and triggers a new bake. The bake
+    // keeps the smallest distance over this band, so a wider one rebakes less but steps shorter.
+    float sdfTolerance = 0.25f;
+    // Skip the ray march in tiles that can't see the mandelbulb and fill them with the background.
+    bool cullTiles = false;
+    // Run the lighting of the compute pass in half precision when the device supports it.
+    bool fp16 = true;
+    // Threads recording the draws of large scenes, 0 records everything on the main thread.
+    uint32_t recordThreads = 0;
+
+    bool isTiled() const { return tiledExtent.width > 0 && tiledExtent.height > 0; }
+    uint32_t tilesX() const { return (tiledExtent.width + tileSize - 1) / tileSize; }
+    uint32_t tilesY() const { return (tiledExtent.height + tileSize - 1) / tileSize; }
+    uint32_t totalFrames() const { return benchmark ? warmupFrames + frameCount : frameCount; }
+};
+
+VkExtent2D parseExtent(const std::string &value)
+{
+    size_t separator = value.find('x');
+    if (separator == std::string::npos)
+    {
+        throw std::invalid_argument("expected WIDTHxHEIGHT, got: " + value);
+    }
+    return {static_cast<uint32_t>(std::stoul(value.substr(0, separator))),
+            static_cast<uint32_t>(std::stoul(value.substr(separator + 1)))};
+}
+
+// Specialization constant ids of the ray marching parameters in mandelbulb.glsl.
+const uint32_t MAX_STEPS_CONSTANT_ID = 2;
+const uint32_t FRACTAL_ITERATIONS_CONSTANT_ID = 3;
+const uint32_t DISTANCE_THRESH_CONSTANT_ID = 4;
+const uint32_t USE_CONE_PREPASS_CONSTANT_ID = 5;
+const uint32_t CONE_TILE_SIZE_CONSTANT_ID = 6;
+const uint32_t CHECKERBOARD_CONSTANT_ID = 7;
+const uint32_t USE_REPROJECTION_CONSTANT_ID = 8;
+const uint32_t USE_SDF_VOLUME_CONSTANT_ID = 9;
+const uint32_t CULL_TILES_CONSTANT_ID = 10;
+const uint32_t CULL_TILE_SIZE_CONSTANT_ID = 11;
+const uint32_t POWER_TOLERANCE_CONSTANT_ID = 12;
+
+// Side of the pixel tiles the cone prepass marches one cone for.
+const uint32_t CONE_TILE_SIZE = 8;
+// Side of the tiles of compute invocations culling keeps or skips as a whole.
+const uint32_t CULL_TILE_SIZE = 32;
+// Bytes the host can write per frame in flight, every allocation takes at least minUniformBufferOffsetAlignment.
+const VkDeviceSize FRAME_ARENA_SIZE = 64 * 1024;
+
+// Order of the passes of a frame, transient images live from their first to their last pass in it.
+enum FramePass : uint32_t
+{
+    BAKE_PASS,
+    CONE_PASS,
+    CLASSIFY_PASS,
+    MANDELBROT_PASS,
+    RESOLVE_PASS,
+    POST_PROCESS_PASS
+};
+
+// How the frame before left the transient images. Every frame reuses their memory, so its first use waits for the
+// compute and post-process passes and the readback copy of the frame before. The contents are thrown away.
+const mcvkp::ResourceUse TRANSIENT_LAST_USE{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                            VK_IMAGE_LAYOUT_UNDEFINED};
+
+const uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 100;
+const uint32_t DEFAULT_BENCHMARK_FRAME_COUNT = 300;
+
+// Stages of the graphics queue that consume the compute target, waited on when compute runs on its own queue.
+const VkPipelineStageFlags COMPUTE_HANDOFF_STAGES = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+AppSettings parseArguments(int argc, char **argv)
+{
+    AppSettings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            settings.headless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            settings.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            settings.offscreenExtent = parseExtent(argv[++i]);
+        }
+        else if (arg == "--readback" && i + 1 < argc)
+        {
+            settings.readbackSlots = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            settings.outputDirectory = argv[++i];
+        }
+        else if (arg == "--tiled" && i + 1 < argc)
+        {
+            settings.tiledExtent = parseExtent(argv[++i]);
+        }
+        else if (arg == "--tile" && i + 1 < argc)
+        {
+            settings.tileSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--output-file" && i + 1 < argc)
+        {
+            settings.outputFile = argv[++i];
+        }
+        else if (arg == "--time" && i + 1 < argc)
+        {
+            settings.fixedTime = std::stof(argv[++i]);
+        }
+        else if (arg == "--sweep" && i + 1 < argc)
+        {
+            settings.sweepFile = argv[++i];
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            settings.batchSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--benchmark")
+        {
+            settings.benchmark = true;
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            settings.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--timestep" && i + 1 < argc)
+        {
+            settings.timestep = std::stof(argv[++i]);
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            settings.reportFile = argv[++i];
+        }
+        else if (arg == "--single-queue")
+        {
+            settings.asyncCompute = false;
+        }
+        else if (arg == "--pipeline-cache" && i + 1 < argc)
+        {
+            settings.pipelineCachePath = argv[++i];
+        }
+        else if (arg == "--shader-cache" && i + 1 < argc)
+        {
+            settings.shaderCachePath = argv[++i];
+        }
+        else if (arg == "--prebuilt-shaders")
+        {
+            settings.prebuiltShaders = true;
+        }
+        else if (arg == "--hot-reload")
+        {
+            settings.hotReload = true;
+        }
+        else if (arg == "--max-steps" && i + 1 < argc)
+        {
+            settings.maxSteps = std::stoi(argv[++i]);
+        }
+        else if (arg == "--iterations" && i + 1 < argc)
+        {
+            settings.fractalIterations = std::stoi(argv[++i]);
+        }
+        else if (arg == "--distance-thresh" && i + 1 < argc)
+        {
+            settings.distanceThreshold = std::stof(argv[++i]);
+        }
+        else if (arg == "--target-ms" && i + 1 < argc)
+        {
+            settings.targetFrameMilliseconds = std::stof(argv[++i]);
+        }
+        else if (arg == "--min-scale" && i + 1 < argc)
+        {
+            settings.minRenderScale = std::stof(argv[++i]);
+        }
+        else if (arg == "--no-reprojection")
+        {
+            settings.reprojection = false;
+        }
+        else if (arg == "--cone-prepass")
+        {
+            settings.conePrepass = true;
+        }
+        else if (arg == "--checkerboard")
+        {
+            settings.checkerboard = true;
+        }
+        else if (arg == "--no-fp16")
+        {
+            settings.fp16 = false;
+        }
+        else if (arg == "--cull-tiles")
+        {
+            settings.cullTiles = true;
+        }
+        else if (arg == "--record-threads" && i + 1 < argc)
+        {
+            settings.recordThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--sdf-volume" && i + 1 < argc)
+        {
+            settings.sdfVolumeSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--sdf-tolerance" && i + 1 < argc)
+        {
+            settings.sdfTolerance = std::stof(argv[++i]);
+        }
+        else if (arg == "--autotune")
+        {
+            settings.autotune = true;
+        }
+        else if (arg == "--autotune-cache" && i + 1 < argc)
+        {
+            settings.autotuneCachePath = argv[++i];
+        }
+        else
+        {
+            throw std::invalid_argument("unknown argument: " + arg);
+        }
+    }
+    if (settings.isTiled())
+    {
+        if (!settings.headless || settings.outputFile.empty())
+        {
+            throw std::invalid_argument("--tiled needs --headless and --output-file");
+        }
+        if (settings.tileSize == 0)
+        {
+            throw std::invalid_argument("--tile must be at least 1");
+        }
+        // Every tile is one frame, read back through the ring into the output file.
+        settings.frameCount = settings.tilesX() * settings.tilesY();
+        if (settings.readbackSlots == 0)
+        {
+            settings.readbackSlots = 3;
+        }
+    }
+    if (settings.hotReload && (!mcvkp::ShaderCompiler::isAvailable() || settings.prebuiltShaders))
+    {
+        throw std::invalid_argument("--hot-reload needs a build with shaderc and can't be combined with --prebuilt-shaders");
+    }
+    if (settings.checkerboard && settings.isTiled())
+    {
+        throw std::invalid_argument("--checkerboard needs consecutive frames and can't be combined with --tiled");
+    }
+    if (!settings.sweepFile.empty() && (!settings.headless || settings.isTiled()))
+    {
+        throw std::invalid_argument("--sweep needs --headless and can't be combined with --tiled");
+    }
+    if (settings.benchmark)
+    {
+        if (settings.isTiled() || !settings.sweepFile.empty())
+        {
+            throw std::invalid_argument("--benchmark can't be combined with --tiled or --sweep");
+        }
+        if (settings.frameCount == 0)
+        {
+            settings.frameCount = DEFAULT_BENCHMARK_FRAME_COUNT;
+        }
+    }
+    // Tiles, readback and benchmarks all expect every frame at full resolution.
+    if (settings.targetFrameMilliseconds > 0 &&
+        (settings.isTiled() || settings.readbackSlots > 0 || settings.benchmark || !settings.sweepFile.empty()))
+    {
+        throw std::invalid_argument("--target-ms can't be combined with --tiled, --readback, --benchmark or --sweep");
+    }
+    if (settings.headless && settings.frameCount == 0)
+    {
+        settings.frameCount = DEFAULT_HEADLESS_FRAME_COUNT;
+    }
+    if (!settings.outputDirectory.empty() && settings.readbackSlots == 0 && settings.sweepFile.empty())
+    {
+        throw std::invalid_argument("--output needs --readback");
+    }
+    return settings;
+}
+
+// Exponent of the mandelbulb at the given scene time, same as getPower in mandelbulb.glsl.
+float getMandelbulbPower(float time)
+{
+    return 10.0f * std::sin(time / 10.0f);
+}
+
 class HelloComputeApplication
 {
 public:
+    HelloComputeApplication(const AppSettings &settings) : settings(settings) {}
+
     void run()
     {
+        if (!settings.sweepFile.empty())
+        {
+            runSweep();
+            return;
+        }
         initVulkan();
         mainLoop();
         cleanup();
     }
 
 private:
-    
+    AppSettings settings;
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // What the compute pass renders and the post-process pass shows. One transient image for every swapchain
+    // image, or one image per swapchain image with async compute.
+    std::shared_ptr<mcvkp::ImageBundle> targetImages;
     std::shared_ptr<mcvkp::ComputeModel> computeModel;
 
     std::shared_ptr<mcvkp::Scene> postProcessScene;
 
+    // Written by updateScene, pushed when the frame's command buffers are recorded.
+    std::shared_ptr<mcvkp::PushConstantBlock> frameConstants;
+    std::shared_ptr<mcvkp::PushConstantBlock> postProcessParams;
+
+    // Data the host writes for every frame, in the region of the frame in flight that records it.
+    std::shared_ptr<mcvkp::UniformArena> frameArena;
+    // Records the draws of large scenes on several threads, into pools of the frame in flight.
+    // Only created with --record-threads, the post-process scene is recorded inline anyway.
+    std::shared_ptr<mcvkp::ParallelRecorder> recorder;
+    // Offset of the frame's group counts in frameArena, rewritten every frame for the current render scale.
+    uint32_t dispatchCommandOffset = 0;
+    std::shared_ptr<mcvkp::ResolutionGovernor> resolutionGovernor;
+
+    // Hit distances of the last two frames, one per layer, written and read by the compute pass in turn.
+    std::shared_ptr<mcvkp::Image> historyImage;
+    glm::vec3 prevCamPosition;
+    VkExtent2D prevRenderExtent = {0, 0};
+
+    // Images that only live within a frame, sharing one allocation where their passes don't overlap.
+    std::shared_ptr<mcvkp::TransientImagePool> transientImages;
+
+    // Start distance of every CONE_TILE_SIZE tile, written by the cone prepass. Always bound, only read with --cone-prepass.
+    // Transient with the prepass, it only lives from the prepass to the compute pass. A single texel without it.
+    std::shared_ptr<mcvkp::Image> coneImage;
+    std::shared_ptr<mcvkp::ComputeModel> coneModel;
+
+    // With --checkerboard the compute pass shades into this image, which keeps the other half from
+    // the frame before, and the resolve pass completes the frame's target from it.
+    std::shared_ptr<mcvkp::Image> shadedImage;
+    std::shared_ptr<mcvkp::ComputeModel> resolveModel;
+
+    // Distance field baked by the bake pass, sampled by the compute pass with --sdf-volume.
+    // Always bound, a single voxel when unused.
+    std::shared_ptr<mcvkp::Image> sdfVolume;
+    std::shared_ptr<mcvkp::ComputeModel> bakeModel;
+    // Set by updateScene in frames that rebake the volume, the others record no bake pass.
+    bool rebakeVolume = false;
+    bool volumeBaked = false;
+    float bakedPower = 0;
+
+    // With --cull-tiles the classify pass lists the tiles the compute pass is dispatched over, one
+    // list per swapchain image. Always bound, a single tile when unused.
+    std::shared_ptr<mcvkp::BufferBundle> tileLists;
+    std::shared_ptr<mcvkp::ComputeModel> classifyModel;
+
+    std::shared_ptr<mcvkp::ReadbackRing> readbackRing;
+    uint64_t readbackFrames = 0;
+
+    std::shared_ptr<MappedFile> tiledOutput;
+
+    std::shared_ptr<mcvkp::GpuTimer> gpuTimer;
+    // Frame last submitted with each swapchain image's command buffer, -1 once its GPU time was collected.
+    std::vector<int64_t> imageFrameIds;
+    FrameStatistics cpuFrameTimes;
+    FrameStatistics gpuFrameTimes;
+
     std::vector<VkCommandBuffer> commandBuffers;
+
+    // Set by initScene when the compute dispatch is submitted to a dedicated compute queue.
+    bool asyncCompute = false;
+    std::vector<VkCommandBuffer> computeCommandBuffers;
+    // Signaled by a frame's compute submission, waited on by its graphics submission.
+    std::vector<VkSemaphore> computeFinishedSemaphores;
     
     const int MAX_FRAMES_IN_FLIGHT = 2;
 
@@ -63,59 +517,583 @@ private:
     std::vector<VkFence> inFlightFences;
     std::vector<VkFence> imagesInFlight;
 
+    // Compiles the compute kernels in the background, null when they are loaded from compile.sh's output.
+    std::shared_ptr<mcvkp::ShaderCompiler> shaderCompiler;
+
+    // With --hot-reload, every kernel is rebuilt from source when a file in shaders/source changes.
+    struct ReloadableKernel
+    {
+        std::shared_ptr<mcvkp::ComputeMaterial> material;
+        std::string name;
+        mcvkp::ShaderDefines defines;
+    };
+    std::shared_ptr<FileWatcher> shaderWatcher;
+    std::vector<ReloadableKernel> reloadableKernels;
+    // Command buffers still bound to pipelines a reload replaced, by swapchain image. Empty when there are none.
+    std::vector<bool> staleCommandBuffers;
+
+    // SPIR-V of the compute kernel name in shaders/source. Without the runtime compiler it is read
+    // from the file compile.sh built the variant into, prebuiltName or name.
+    std::shared_future<std::vector<char> > loadKernel(const std::string &name,
+                                                      const mcvkp::ShaderDefines &defines = {},
+                                                      const std::string &prebuiltName = "")
+    {
+        if (shaderCompiler)
+        {
+            return shaderCompiler->compile(path_prefix + "/shaders/source/" + name + ".comp", VK_SHADER_STAGE_COMPUTE_BIT, defines);
+        }
+        std::promise<std::vector<char> > prebuilt;
+        prebuilt.set_value(readFile(path_prefix + "/shaders/generated/" + (prebuiltName.empty() ? name : prebuiltName) + ".spv"));
+        return prebuilt.get_future().share();
+    }
+
     // Initializing layouts and models.
     void initScene()
     {
         using namespace mcvkp;
         uint32_t descriptorSetsSize = VulkanGlobal::swapchainContext.swapChainImageViews.size();
 
-        auto uniformBufferBundle = std::make_shared<mcvkp::BufferBundle>(descriptorSetsSize);
-        BufferUtils::createBundle<UniformBufferObject>(uniformBufferBundle.get(), UniformBufferObject(),
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-        auto targetTexture = std::make_shared<mcvkp::Image>();
-        mcvkp::ImageUtils::createImage(VulkanGlobal::swapchainContext.swapChainExtent.width,
-                                       VulkanGlobal::swapchainContext.swapChainExtent.height,
-                                       1,
-                                       VK_SAMPLE_COUNT_1_BIT,
-                                       VK_FORMAT_R8G8B8A8_UNORM,
-                                       VK_IMAGE_TILING_OPTIMAL,
-                                       VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-                                       VK_IMAGE_ASPECT_COLOR_BIT,
-                                       VMA_MEMORY_USAGE_GPU_ONLY,
-                                       targetTexture);
-        mcvkp::ImageUtils::transitionImageLayout(targetTexture->image,
-                                                 VK_FORMAT_R8G8B8A8_UNORM,
+        if (ShaderCompiler::isAvailable() && !settings.prebuiltShaders)
+        {
+            shaderCompiler = std::make_shared<ShaderCompiler>(settings.shaderCachePath);
+        }
+
+        // The half precision build declares 16 bit float arithmetic, which only loads with shaderFloat16 enabled.
+        // Its own autotuner entry, as it may prefer other workgroup sizes.
+        bool useFp16 = settings.fp16 && VulkanGlobal::context.shaderFloat16;
+        std::string kernelName = useFp16 ? "mandelbrot-fp16" : "mandelbrot";
+        std::cout << "Compute kernel: " << kernelName << "\n";
+
+        // Every kernel is requested up front, so a cold cache compiles them while the images are created.
+        ShaderDefines mandelbrotDefines = useFp16 ? ShaderDefines{{"USE_FP16", "1"}} : ShaderDefines{};
+        auto mandelbrotCode = loadKernel("mandelbrot", mandelbrotDefines, kernelName);
+        auto coneCode = loadKernel("mandelbrot-cone");
+        auto resolveCode = loadKernel("checkerboard-resolve");
+        auto bakeCode = loadKernel("sdf-bake");
+        auto classifyCode = loadKernel("tile-classify");
+
+        frameConstants = std::make_shared<PushConstantBlock>();
+        // Also holds the group counts of the compute dispatch when tiles aren't culled.
+        frameArena = std::make_shared<UniformArena>(MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_SIZE, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        if (settings.recordThreads > 0)
+        {
+            recorder = std::make_shared<ParallelRecorder>(MAX_FRAMES_IN_FLIGHT,
+                                                          VulkanGlobal::context.queueFamilyIndices.graphicsFamily.value(),
+                                                          settings.recordThreads);
+        }
+
+        // Tiled rendering only keeps one tile per frame in flight on the GPU, whatever the size of the output.
+        VkExtent2D targetExtent = VulkanGlobal::swapchainContext.swapChainExtent;
+        if (settings.isTiled())
+        {
+            targetExtent = {settings.tileSize, settings.tileSize};
+            uint64_t outputSize = static_cast<uint64_t>(settings.tiledExtent.width) * settings.tiledExtent.height * 4;
+            tiledOutput = std::make_shared<MappedFile>(settings.outputFile, outputSize);
+        }
+
+        asyncCompute = VulkanGlobal::context.hasDedicatedComputeQueue();
+        transientImages = std::make_shared<TransientImagePool>();
+
+        VkImageUsageFlags targetUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        targetImages = std::make_shared<mcvkp::ImageBundle>(descriptorSetsSize);
+        if (asyncCompute)
+        {
+            // One target per swapchain image, so a frame's compute doesn't have to wait for the previous
+            // frame to finish sampling its target on the graphics queue.
+            for (auto &targetTexture : targetImages->images)
+            {
+                mcvkp::ImageUtils::createImage(targetExtent.width,
+                                               targetExtent.height,
+                                               1,
+                                               VK_SAMPLE_COUNT_1_BIT,
+                                               VK_FORMAT_R8G8B8A8_UNORM,
+                                               VK_IMAGE_TILING_OPTIMAL,
+                                               targetUsage,
+                                               VK_IMAGE_ASPECT_COLOR_BIT,
+                                               VMA_MEMORY_USAGE_GPU_ONLY,
+                                               targetTexture);
+                mcvkp::ImageUtils::transitionImageLayout(targetTexture->image,
+                                                         VK_FORMAT_R8G8B8A8_UNORM,
+                                                         VK_IMAGE_LAYOUT_UNDEFINED,
+                                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                         1);
+            }
+        }
+        else
+        {
+            // On one queue the frames run one after another and every frame writes all of the target
+            // it shows, so they share one transient target. Its first pass writes it.
+            FramePass firstTargetPass = settings.checkerboard ? RESOLVE_PASS : (settings.cullTiles ? CLASSIFY_PASS : MANDELBROT_PASS);
+            auto targetImage = transientImages->declare(targetExtent.width,
+                                                        targetExtent.height,
+                                                        VK_FORMAT_R8G8B8A8_UNORM,
+                                                        targetUsage,
+                                                        VK_IMAGE_ASPECT_COLOR_BIT,
+                                                        firstTargetPass,
+                                                        POST_PROCESS_PASS);
+            targetImages->images.assign(descriptorSetsSize, targetImage);
+        }
+        historyImage = std::make_shared<mcvkp::Image>();
+        mcvkp::ImageUtils::createImageArray(targetExtent.width,
+                                            targetExtent.height,
+                                            2,
+                                            VK_FORMAT_R32_SFLOAT,
+                                            VK_IMAGE_USAGE_STORAGE_BIT,
+                                            VK_IMAGE_ASPECT_COLOR_BIT,
+                                            VMA_MEMORY_USAGE_GPU_ONLY,
+                                            historyImage);
+        mcvkp::ImageUtils::transitionImageLayout(historyImage->image,
+                                                 VK_FORMAT_R32_SFLOAT,
+                                                 VK_IMAGE_LAYOUT_UNDEFINED,
+                                                 VK_IMAGE_LAYOUT_GENERAL,
+                                                 1,
+                                                 2);
+
+        if (settings.conePrepass)
+        {
+            VkExtent2D coneExtent = {(targetExtent.width + CONE_TILE_SIZE - 1) / CONE_TILE_SIZE,
+                                     (targetExtent.height + CONE_TILE_SIZE - 1) / CONE_TILE_SIZE};
+            coneImage = transientImages->declare(coneExtent.width,
+                                                 coneExtent.height,
+                                                 VK_FORMAT_R32_SFLOAT,
+                                                 VK_IMAGE_USAGE_STORAGE_BIT,
+                                                 VK_IMAGE_ASPECT_COLOR_BIT,
+                                                 CONE_PASS,
+                                                 MANDELBROT_PASS);
+        }
+        else
+        {
+            // Only bound, the compute pass doesn't read it without the prepass.
+            coneImage = std::make_shared<mcvkp::Image>();
+            mcvkp::ImageUtils::createImage(1,
+                                           1,
+                                           1,
+                                           VK_SAMPLE_COUNT_1_BIT,
+                                           VK_FORMAT_R32_SFLOAT,
+                                           VK_IMAGE_TILING_OPTIMAL,
+                                           VK_IMAGE_USAGE_STORAGE_BIT,
+                                           VK_IMAGE_ASPECT_COLOR_BIT,
+                                           VMA_MEMORY_USAGE_GPU_ONLY,
+                                           coneImage);
+            mcvkp::ImageUtils::transitionImageLayout(coneImage->image,
+                                                     VK_FORMAT_R32_SFLOAT,
+                                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                                     VK_IMAGE_LAYOUT_GENERAL,
+                                                     1);
+        }
+        // Transient images have no layout to start in, every frame imports them undefined.
+        transientImages->allocate();
+        vkDeviceWaitIdle(VulkanGlobal::context.device);
+
+        uint32_t volumeSize = std::max(settings.sdfVolumeSize, 1u);
+        sdfVolume = std::make_shared<mcvkp::Image>();
+        mcvkp::ImageUtils::createImage3D(volumeSize,
+                                         volumeSize,
+                                         volumeSize,
+                                         VK_FORMAT_R16_SFLOAT,
+                                         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+                                         VK_IMAGE_ASPECT_COLOR_BIT,
+                                         VMA_MEMORY_USAGE_GPU_ONLY,
+                                         sdfVolume);
+        mcvkp::ImageUtils::transitionImageLayout(sdfVolume->image,
+                                                 VK_FORMAT_R16_SFLOAT,
                                                  VK_IMAGE_LAYOUT_UNDEFINED,
                                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                                  1);
         vkDeviceWaitIdle(VulkanGlobal::context.device);
-        auto computeMaterial = std::make_shared<ComputeMaterial>(path_prefix + "/shaders/generated/mandelbrot.spv");
-        computeMaterial->addBufferBundle(uniformBufferBundle, VK_SHADER_STAGE_COMPUTE_BIT);
-        computeMaterial->addStorageImage(targetTexture, VK_SHADER_STAGE_COMPUTE_BIT);
+        auto sdfVolumeTexture = std::make_shared<Texture>(sdfVolume);
 
-        computeModel = std::make_shared<ComputeModel>(computeMaterial);
+        if (settings.sdfVolumeSize > 0)
+        {
+            if (!VulkanGlobal::context.enabledFeatures.shaderStorageImageExtendedFormats)
+            {
+                throw std::runtime_error("baking the distance volume needs shaderStorageImageExtendedFormats!");
+            }
+            auto bakeMaterial = std::make_shared<ComputeMaterial>(bakeCode);
+            bakeMaterial->setPushConstants(frameConstants, sizeof(DispatchBounds));
+            bakeMaterial->addStorageImage("sdfVolume", sdfVolume, VK_SHADER_STAGE_COMPUTE_BIT);
+            bakeMaterial->setWorkgroupSize(WorkgroupAutotuner::clampToDevice({8, 8}));
+            bakeMaterial->addSpecializationConstant(FRACTAL_ITERATIONS_CONSTANT_ID, settings.fractalIterations);
+            bakeMaterial->addSpecializationConstant(POWER_TOLERANCE_CONSTANT_ID, settings.sdfTolerance);
+            bakeModel = std::make_shared<ComputeModel>(bakeMaterial);
+        }
+
+        if (settings.checkerboard)
+        {
+            shadedImage = std::make_shared<mcvkp::Image>();
+            mcvkp::ImageUtils::createImage(targetExtent.width,
+                                           targetExtent.height,
+                                           1,
+                                           VK_SAMPLE_COUNT_1_BIT,
+                                           VK_FORMAT_R8G8B8A8_UNORM,
+                                           VK_IMAGE_TILING_OPTIMAL,
+                                           VK_IMAGE_USAGE_STORAGE_BIT,
+                                           VK_IMAGE_ASPECT_COLOR_BIT,
+                                           VMA_MEMORY_USAGE_GPU_ONLY,
+                                           shadedImage);
+            mcvkp::ImageUtils::transitionImageLayout(shadedImage->image,
+                                                     VK_FORMAT_R8G8B8A8_UNORM,
+                                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                                     VK_IMAGE_LAYOUT_GENERAL,
+                                                     1);
+            vkDeviceWaitIdle(VulkanGlobal::context.device);
+
+            auto resolveMaterial = std::make_shared<ComputeMaterial>(resolveCode);
+            resolveMaterial->setPushConstants(frameConstants, sizeof(DispatchBounds));
+            resolveMaterial->addStorageImageBundle("img", targetImages, VK_SHADER_STAGE_COMPUTE_BIT);
+            resolveMaterial->addStorageImage("shaded", shadedImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            resolveMaterial->setWorkgroupSize(WorkgroupAutotuner::clampToDevice({32, 32}));
+            resolveModel = std::make_shared<ComputeModel>(resolveMaterial);
+        }
+
+        if (settings.conePrepass)
+        {
+            auto coneMaterial = std::make_shared<ComputeMaterial>(coneCode);
+            coneMaterial->setPushConstants(frameConstants, sizeof(DispatchBounds));
+            coneMaterial->addStorageImage("coneDistances", coneImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            coneMaterial->setWorkgroupSize(WorkgroupAutotuner::clampToDevice({8, 8}));
+            coneMaterial->addSpecializationConstant(MAX_STEPS_CONSTANT_ID, settings.maxSteps);
+            coneMaterial->addSpecializationConstant(FRACTAL_ITERATIONS_CONSTANT_ID, settings.fractalIterations);
+            coneMaterial->addSpecializationConstant(DISTANCE_THRESH_CONSTANT_ID, settings.distanceThreshold);
+            coneMaterial->addSpecializationConstant(CONE_TILE_SIZE_CONSTANT_ID, CONE_TILE_SIZE);
+            coneModel = std::make_shared<ComputeModel>(coneMaterial);
+        }
+
+        // Tiles of invocations, a checkerboarded row only has one for every other pixel.
+        uint32_t invocationWidth = settings.checkerboard ? (targetExtent.width + 1) / 2 : targetExtent.width;
+        VkExtent2D tileCount = {(invocationWidth + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE,
+                                (targetExtent.height + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE};
+        VkDeviceSize tileListSize = sizeof(VkDispatchIndirectCommand) +
+                                    sizeof(uint32_t) * (settings.cullTiles ? tileCount.width * tileCount.height : 1);
+        tileLists = std::make_shared<mcvkp::BufferBundle>(descriptorSetsSize);
+        for (auto &tileList : tileLists->buffers)
+        {
+            tileList->size = tileListSize;
+            BufferUtils::allocate(tileList.get(),
+                                  tileListSize,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        if (settings.cullTiles)
+        {
+            auto classifyMaterial = std::make_shared<ComputeMaterial>(classifyCode);
+            classifyMaterial->setPushConstants(frameConstants, sizeof(DispatchBounds));
+            if (shadedImage)
+            {
+                classifyMaterial->addStorageImage("img", shadedImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            }
+            else
+            {
+                classifyMaterial->addStorageImageBundle("img", targetImages, VK_SHADER_STAGE_COMPUTE_BIT);
+            }
+            classifyMaterial->addStorageImage("history", historyImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            classifyMaterial->addStorageBufferBundle("tileList", tileLists, VK_SHADER_STAGE_COMPUTE_BIT);
+            classifyMaterial->setWorkgroupSize(WorkgroupAutotuner::clampToDevice({8, 8}));
+            classifyMaterial->addSpecializationConstant(FRACTAL_ITERATIONS_CONSTANT_ID, settings.fractalIterations);
+            classifyMaterial->addSpecializationConstant(DISTANCE_THRESH_CONSTANT_ID, settings.distanceThreshold);
+            classifyMaterial->addSpecializationConstant(CHECKERBOARD_CONSTANT_ID, static_cast<VkBool32>(settings.checkerboard));
+            classifyMaterial->addSpecializationConstant(CULL_TILE_SIZE_CONSTANT_ID, CULL_TILE_SIZE);
+            classifyModel = std::make_shared<ComputeModel>(classifyMaterial);
+        }
+
+        if (settings.targetFrameMilliseconds > 0)
+        {
+            resolutionGovernor = std::make_shared<ResolutionGovernor>(settings.targetFrameMilliseconds, settings.minRenderScale);
+        }
+
+        postProcessParams = std::make_shared<PushConstantBlock>();
+        postProcessParams->set(PostProcessParams{glm::vec2(1.0f)});
+
+        auto createComputeModel = [&](VkExtent2D workgroupSize, bool cullTiles)
+        {
+            auto computeMaterial = std::make_shared<ComputeMaterial>(mandelbrotCode);
+            computeMaterial->setPushConstants(frameConstants, sizeof(DispatchBounds));
+            computeMaterial->addTexture("sdfVolume", sdfVolumeTexture, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (shadedImage)
+            {
+                computeMaterial->addStorageImage("img", shadedImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            }
+            else
+            {
+                computeMaterial->addStorageImageBundle("img", targetImages, VK_SHADER_STAGE_COMPUTE_BIT);
+            }
+            computeMaterial->addStorageImage("history", historyImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            computeMaterial->addStorageImage("coneDistances", coneImage, VK_SHADER_STAGE_COMPUTE_BIT);
+            computeMaterial->addStorageBufferBundle("tileList", tileLists, VK_SHADER_STAGE_COMPUTE_BIT);
+            computeMaterial->setWorkgroupSize(workgroupSize);
+            computeMaterial->addSpecializationConstant(MAX_STEPS_CONSTANT_ID, settings.maxSteps);
+            computeMaterial->addSpecializationConstant(FRACTAL_ITERATIONS_CONSTANT_ID, settings.fractalIterations);
+            computeMaterial->addSpecializationConstant(DISTANCE_THRESH_CONSTANT_ID, settings.distanceThreshold);
+            computeMaterial->addSpecializationConstant(USE_CONE_PREPASS_CONSTANT_ID, static_cast<VkBool32>(settings.conePrepass));
+            computeMaterial->addSpecializationConstant(CONE_TILE_SIZE_CONSTANT_ID, CONE_TILE_SIZE);
+            computeMaterial->addSpecializationConstant(CHECKERBOARD_CONSTANT_ID, static_cast<VkBool32>(settings.checkerboard));
+            computeMaterial->addSpecializationConstant(USE_REPROJECTION_CONSTANT_ID, static_cast<VkBool32>(settings.reprojection));
+            computeMaterial->addSpecializationConstant(USE_SDF_VOLUME_CONSTANT_ID, static_cast<VkBool32>(settings.sdfVolumeSize > 0));
+            computeMaterial->addSpecializationConstant(CULL_TILES_CONSTANT_ID, static_cast<VkBool32>(cullTiles));
+            computeMaterial->addSpecializationConstant(CULL_TILE_SIZE_CONSTANT_ID, CULL_TILE_SIZE);
+            return std::make_shared<ComputeModel>(computeMaterial);
+        };
+
+        // The winner depends on the GPU, so it is only looked up for this device and driver.
+        // Tuning renders real frames, which needs the frame constants filled in first.
+        WorkgroupAutotuner autotuner(settings.autotuneCachePath);
+        std::optional<VkExtent2D> workgroupSize = autotuner.getCached(kernelName);
+        computeModel = createComputeModel(workgroupSize.value_or(WorkgroupAutotuner::clampToDevice({32, 32})), settings.cullTiles);
+        if (settings.autotune)
+        {
+            frameArena->beginFrame(0);
+            updateScene(0);
+            frameArena->flush();
+            // Candidates are timed with a baked volume and the start distances of a real prepass.
+            if (bakeModel || coneModel)
+            {
+                RenderGraph graph;
+                if (bakeModel)
+                {
+                    RenderGraph::Resource volume = graph.importImage(sdfVolume->image, ResourceUses::sampledCompute);
+                    addVolumeBakePass(graph, volume, 0);
+                    graph.exportResource(volume, ResourceUses::sampledCompute);
+                }
+                if (coneModel)
+                {
+                    RenderGraph::Resource cone = graph.importImage(coneImage->image, TRANSIENT_LAST_USE);
+                    graph.aliasMemory(cone, transientImages->getAliasedBefore(coneImage));
+                    addConePrepass(graph, cone, 0);
+                    graph.exportResource(cone, ResourceUses::storageRead);
+                }
+                VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
+                graph.execute(commandBuffer);
+                RenderSystem::endSingleTimeCommands(commandBuffer);
+            }
+            // The shaded image stays in GENERAL, unlike the targets the post-process pass samples.
+            VkImageLayout outputLayout = shadedImage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            // Candidates are dispatched over the whole output, culling has no tile list to run on there.
+            auto createUnculledModel = [&](VkExtent2D candidate)
+            { return createComputeModel(candidate, false); };
+            computeModel = createComputeModel(autotuner.tune(kernelName, targetExtent, createUnculledModel, outputLayout), settings.cullTiles);
+        }
+
+        if (settings.hotReload)
+        {
+            shaderWatcher = std::make_shared<FileWatcher>(path_prefix + "/shaders/source");
+            reloadableKernels.push_back({computeModel->getMaterial(), "mandelbrot", mandelbrotDefines});
+            for (auto &kernel : {std::make_pair(coneModel, "mandelbrot-cone"),
+                                 std::make_pair(resolveModel, "checkerboard-resolve"),
+                                 std::make_pair(bakeModel, "sdf-bake"),
+                                 std::make_pair(classifyModel, "tile-classify")})
+            {
+                if (kernel.first)
+                {
+                    reloadableKernels.push_back({kernel.first->getMaterial(), kernel.second, {}});
+                }
+            }
+        }
 
         postProcessScene = std::make_shared<Scene>(RenderPassType::eFlat);
 
-        auto screenTex = std::make_shared<Texture>(targetTexture);
+        auto screenTextures = std::make_shared<TextureBundle>(*targetImages);
         auto screenMaterial = std::make_shared<Material>(
             path_prefix + "/shaders/generated/post-process-vert.spv",
             path_prefix + "/shaders/generated/post-process-frag.spv");
-        screenMaterial->addTexture(screenTex, VK_SHADER_STAGE_FRAGMENT_BIT);
+        screenMaterial->setPushConstants(postProcessParams);
+        screenMaterial->addTextureBundle("texSampler", screenTextures, VK_SHADER_STAGE_FRAGMENT_BIT);
         postProcessScene->addModel(std::make_shared<DrawableModel>(screenMaterial, MeshType::ePlane));
+
+        if (settings.readbackSlots > 0)
+        {
+            readbackRing = std::make_shared<ReadbackRing>(settings.readbackSlots,
+                                                          targetExtent.width,
+                                                          targetExtent.height,
+                                                          4,
+                                                          [this](const ReadbackFrame &frame)
+                                                          { consumeFrame(frame); });
+        }
+    }
+
+    // Rebakes the distance volume the compute pass samples.
+    void addVolumeBakePass(mcvkp::RenderGraph &graph, mcvkp::RenderGraph::Resource volume, size_t imageIndex)
+    {
+        graph.addPass("sdf-bake", {{volume, mcvkp::ResourceUses::storageWrite}}, [this, imageIndex](VkCommandBuffer commandBuffer)
+                      { bakeModel->dispatch(commandBuffer, imageIndex, {sdfVolume->width, sdfVolume->height, sdfVolume->depth}); });
+    }
+
+    // Marches the cones of every tile of the target for the main dispatch.
+    void addConePrepass(mcvkp::RenderGraph &graph, mcvkp::RenderGraph::Resource cone, size_t imageIndex)
+    {
+        // Tiles outside the current render scale are skipped by the shader.
+        graph.addPass("mandelbrot-cone", {{cone, mcvkp::ResourceUses::storageWrite}}, [this, imageIndex](VkCommandBuffer commandBuffer)
+                      { coneModel->dispatch(commandBuffer, imageIndex, {coneImage->width, coneImage->height, 1}); });
+    }
+
+    // Lists the tiles that can see the mandelbulb for the compute pass's indirect dispatch and fills
+    // the others with the background. The group counts across a tile follow the compute pass's workgroup size.
+    void addTileClassificationPasses(mcvkp::RenderGraph &graph,
+                                     mcvkp::RenderGraph::Resource tileList,
+                                     mcvkp::RenderGraph::Resource output,
+                                     mcvkp::RenderGraph::Resource history,
+                                     size_t imageIndex)
+    {
+        graph.addPass("clear tile list", {{tileList, mcvkp::ResourceUses::transferWrite}}, [this, imageIndex](VkCommandBuffer commandBuffer)
+                      {
+                          VkExtent2D workgroupSize = computeModel->getMaterial()->getWorkgroupSize();
+                          VkDispatchIndirectCommand emptyList{0,
+                                                              (CULL_TILE_SIZE + workgroupSize.width - 1) / workgroupSize.width,
+                                                              (CULL_TILE_SIZE + workgroupSize.height - 1) / workgroupSize.height};
+                          vkCmdUpdateBuffer(commandBuffer, tileLists->buffers[imageIndex]->buffer, 0, sizeof(emptyList), &emptyList);
+                      });
+
+        // One workgroup per tile, tiles past the current render scale are skipped by the shader.
+        graph.addPass("tile-classify",
+                      {{tileList, mcvkp::ResourceUses::storageReadWrite}, {output, mcvkp::ResourceUses::storageWrite}, {history, mcvkp::ResourceUses::storageWrite}},
+                      [this, imageIndex](VkCommandBuffer commandBuffer)
+                      {
+                          VkExtent2D classifyWorkgroup = classifyModel->getMaterial()->getWorkgroupSize();
+                          auto targetImage = targetImages->images[imageIndex];
+                          uint32_t invocationWidth = settings.checkerboard ? (targetImage->width + 1) / 2 : targetImage->width;
+                          uint32_t tilesX = (invocationWidth + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE;
+                          uint32_t tilesY = (targetImage->height + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE;
+                          classifyModel->dispatch(commandBuffer, imageIndex, {tilesX * classifyWorkgroup.width, tilesY * classifyWorkgroup.height, 1});
+                      });
+    }
+
+    glm::ivec2 getTileOffset(uint64_t tileIndex)
+    {
+        return glm::ivec2((tileIndex % settings.tilesX()) * settings.tileSize,
+                          (tileIndex / settings.tilesX()) * settings.tileSize);
+    }
+
+    // Copies a read back tile into its place in the output file, clipped at the right and bottom edges.
+    void writeTile(const mcvkp::ReadbackFrame &frame)
+    {
+        glm::ivec2 offset = getTileOffset(frame.frameId);
+        uint32_t width = std::min(frame.width, settings.tiledExtent.width - offset.x);
+        uint32_t height = std::min(frame.height, settings.tiledExtent.height - offset.y);
+        uint64_t outputPitch = static_cast<uint64_t>(settings.tiledExtent.width) * 4;
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const uint8_t *src = static_cast<const uint8_t *>(frame.data) + y * frame.rowPitch;
+            uint8_t *dst = tiledOutput->data + (offset.y + y) * outputPitch + static_cast<uint64_t>(offset.x) * 4;
+            memcpy(dst, src, width * 4);
+        }
+    }
+
+    // Called by the readback ring a few frames after a frame was rendered.
+    void consumeFrame(const mcvkp::ReadbackFrame &frame)
+    {
+        readbackFrames++;
+        if (tiledOutput)
+        {
+            writeTile(frame);
+            return;
+        }
+        if (settings.outputDirectory.empty())
+        {
+            return;
+        }
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "/frame_%05llu.ppm", static_cast<unsigned long long>(frame.frameId));
+        std::ofstream file(settings.outputDirectory + fileName, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open output file!");
+        }
+        file << "P6\n"
+             << frame.width << " " << frame.height << "\n255\n";
+
+        // The target is RGBA8, PPM wants RGB.
+        std::vector<char> row(frame.width * 3);
+        for (uint32_t y = 0; y < frame.height; y++)
+        {
+            const char *pixels = static_cast<const char *>(frame.data) + y * frame.rowPitch;
+            for (uint32_t x = 0; x < frame.width; x++)
+            {
+                row[x * 3 + 0] = pixels[x * 4 + 0];
+                row[x * 3 + 1] = pixels[x * 4 + 1];
+                row[x * 3 + 2] = pixels[x * 4 + 2];
+            }
+            file.write(row.data(), row.size());
+        }
+    }
+
+    // Seconds since the application started. Doesn't depend on glfw so it works headless.
+    float getTime()
+    {
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - startTime;
+        return elapsed.count();
+    }
+
+    // Time the scene is rendered at. Benchmarks advance it by a fixed step per frame,
+    // so every run renders exactly the same frames.
+    float getSceneTime()
+    {
+        if (settings.benchmark)
+        {
+            return renderedFrames * settings.timestep;
+        }
+        return getTime();
     }
 
     void updateScene(uint32_t currentImage)
     {
-        float currentTime = (float)glfwGetTime();
-        UniformBufferObject ubo = {camera.Position, currentTime};
+        auto targetImage = targetImages->images[currentImage];
+        VkExtent2D renderExtent = {targetImage->width, targetImage->height};
+        if (resolutionGovernor)
+        {
+            renderExtent = resolutionGovernor->getExtent(renderExtent);
+        }
+
+        FrameConstants constants{};
+        constants.camPosition = camera.Position;
+        if (settings.isTiled())
+        {
+            constants.time = settings.fixedTime;
+            constants.tileOffset = getTileOffset(renderedFrames);
+            constants.outputExtent = glm::ivec2(settings.tiledExtent.width, settings.tiledExtent.height);
+        }
+        else
+        {
+            constants.time = getSceneTime();
+            constants.tileOffset = glm::ivec2(0);
+            constants.outputExtent = glm::ivec2(renderExtent.width, renderExtent.height);
+        }
 
-        auto &allocation = computeModel->getMaterial()->getBufferBundles()[0].data->buffers[currentImage]->allocation;
-        void *data;
-        vmaMapMemory(VulkanGlobal::context.allocator, allocation, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vmaUnmapMemory(VulkanGlobal::context.allocator, allocation);
+        // Tiles don't overlap, so there is nothing to build on between them.
+        constants.prevCamPosition = prevCamPosition;
+        constants.historyValid = !settings.isTiled() && renderedFrames > 0;
+        constants.prevOutputExtent = glm::ivec2(prevRenderExtent.width, prevRenderExtent.height);
+        constants.historyLayer = renderedFrames % 2;
+        constants.checkerboardParity = renderedFrames % 2;
+        prevCamPosition = camera.Position;
+        prevRenderExtent = renderExtent;
+        frameConstants->set(constants);
+
+        // The power animates, but the volume holds the smallest distance over the tolerance band
+        // around the power it was baked at, so it is only rebaked once the power leaves the band.
+        if (bakeModel)
+        {
+            float power = getMandelbulbPower(constants.time);
+            rebakeVolume = !volumeBaked || std::abs(power - bakedPower) > settings.sdfTolerance;
+            if (rebakeVolume)
+            {
+                volumeBaked = true;
+                bakedPower = power;
+            }
+        }
+
+        // Only the top left renderExtent of the target is rendered and the post-process pass stretches it over the screen.
+        // A checkerboarded row only needs an invocation for every other pixel.
+        uint32_t shadedWidth = settings.checkerboard ? (renderExtent.width + 1) / 2 : renderExtent.width;
+        VkExtent3D groupCount = computeModel->getGroupCount({shadedWidth, renderExtent.height, 1});
+        VkDispatchIndirectCommand dispatchCommand{groupCount.width, groupCount.height, groupCount.depth};
+        dispatchCommandOffset = frameArena->allocate(dispatchCommand);
+
+        PostProcessParams params{};
+        params.renderScale = glm::vec2(static_cast<float>(renderExtent.width) / targetImage->width,
+                                       static_cast<float>(renderExtent.height) / targetImage->height);
+        postProcessParams->set(params);
     }
 
     void createCommandBuffers()
@@ -127,69 +1105,205 @@ private:
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
 
-        auto tagetImage = computeModel->getMaterial()->getStorageImages()[0].data;
         if (vkAllocateCommandBuffers(VulkanGlobal::context.device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to allocate command buffers!");
         }
 
-        for (size_t i = 0; i < commandBuffers.size(); i++)
+        if (asyncCompute)
         {
+            computeCommandBuffers.resize(commandBuffers.size());
+            allocInfo.commandPool = VulkanGlobal::context.computeCommandPool;
+            if (vkAllocateCommandBuffers(VulkanGlobal::context.device, &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate compute command buffers!");
+            }
+        }
+    }
 
-            VkCommandBufferBeginInfo beginInfo{};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = 0;                  // Optional
-            beginInfo.pInheritanceInfo = nullptr; // Optional
+    // Records the frame of swapchain image i, which must not be in flight.
+    void recordCommandBuffers(size_t i)
+    {
+        uint32_t graphicsFamily = VulkanGlobal::context.queueFamilyIndices.graphicsFamily.value();
+        uint32_t computeFamily = VulkanGlobal::context.queueFamilyIndices.computeFamily.value();
 
-            if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+        auto tagetImage = targetImages->images[i];
+        // Without a dedicated compute queue everything goes into the graphics command buffer.
+        VkCommandBuffer computeCommandBuffer = asyncCompute ? computeCommandBuffers[i] : commandBuffers[i];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = 0;                  // Optional
+        beginInfo.pInheritanceInfo = nullptr; // Optional
+
+        if (vkBeginCommandBuffer(computeCommandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        if (gpuTimer)
+        {
+            gpuTimer->begin(computeCommandBuffer, i);
+        }
+
+        // The barriers between the passes come from what the passes declare they use. Resources are
+        // imported as the previous frame left them, maybe from another command buffer.
+        mcvkp::RenderGraph graph;
+        // The frame overwrites every pixel that is sampled. With async compute the image is taken over
+        // without an acquire from the graphics family, the fence of the frame that last used this image has
+        // been waited on before this is submitted. Otherwise it is the transient target.
+        mcvkp::RenderGraph::Resource target;
+        if (asyncCompute)
+        {
+            target = graph.importImage(tagetImage->image, mcvkp::ResourceUse{});
+        }
+        else
+        {
+            target = graph.importImage(tagetImage->image, TRANSIENT_LAST_USE);
+            graph.aliasMemory(target, transientImages->getAliasedBefore(tagetImage));
+        }
+        mcvkp::RenderGraph::Resource history = graph.importImage(historyImage->image, mcvkp::ResourceUses::storageReadWrite);
+        graph.markOutput(history);
+        mcvkp::RenderGraph::Resource output = target;
+        if (shadedImage)
+        {
+            // Keeps the half of the pixels the next frame doesn't shade.
+            output = graph.importImage(shadedImage->image, mcvkp::ResourceUses::storageReadWrite);
+            graph.markOutput(output);
+        }
+
+        std::vector<mcvkp::RenderGraph::PassUse> computeUses = {{output, mcvkp::ResourceUses::storageWrite}, {history, mcvkp::ResourceUses::storageReadWrite}};
+        if (bakeModel)
+        {
+            mcvkp::RenderGraph::Resource volume = graph.importImage(sdfVolume->image, mcvkp::ResourceUses::sampledCompute);
+            graph.markOutput(volume);
+            if (rebakeVolume)
             {
-                throw std::runtime_error("failed to begin recording command buffer!");
+                addVolumeBakePass(graph, volume, i);
             }
+            computeUses.push_back({volume, mcvkp::ResourceUses::sampledCompute});
+        }
+
+        if (coneModel)
+        {
+            mcvkp::RenderGraph::Resource cone = graph.importImage(coneImage->image, TRANSIENT_LAST_USE);
+            graph.aliasMemory(cone, transientImages->getAliasedBefore(coneImage));
+            addConePrepass(graph, cone, i);
+            computeUses.push_back({cone, mcvkp::ResourceUses::storageRead});
+        }
 
-            VkImageMemoryBarrier computeMemoryBarrier = {};
-            computeMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            computeMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            computeMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-            computeMemoryBarrier.image = tagetImage->image;
-            computeMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-            computeMemoryBarrier.srcAccessMask = 0;
-            computeMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        if (classifyModel)
+        {
+            mcvkp::ResourceUse listLastUse{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                           VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+            mcvkp::RenderGraph::Resource tileList = graph.importBuffer(tileLists->buffers[i]->buffer, listLastUse);
+            addTileClassificationPasses(graph, tileList, output, history, i);
+            computeUses.push_back({tileList, mcvkp::ResourceUses::indirectRead});
+            computeUses.push_back({tileList, mcvkp::ResourceUses::storageRead});
+        }
+
+        graph.addPass("mandelbrot", computeUses, [this, i, tagetImage](VkCommandBuffer commandBuffer)
+                      {
+                          // Culling replaces the host's group counts with the tile list's.
+                          VkBuffer dispatchBuffer = classifyModel ? tileLists->buffers[i]->buffer : frameArena->getBuffer();
+                          VkDeviceSize dispatchOffset = classifyModel ? 0 : dispatchCommandOffset;
+                          computeModel->dispatchIndirect(commandBuffer, i, {tagetImage->width, tagetImage->height, 1}, dispatchBuffer, dispatchOffset);
+                      });
+
+        if (resolveModel)
+        {
+            // Pixels outside the current render scale are skipped by the shader.
+            graph.addPass("checkerboard-resolve", {{output, mcvkp::ResourceUses::storageRead}, {target, mcvkp::ResourceUses::storageWrite}}, [this, i, tagetImage](VkCommandBuffer commandBuffer)
+                          { resolveModel->dispatch(commandBuffer, i, {tagetImage->width, tagetImage->height, 1}); });
+        }
+
+        if (asyncCompute)
+        {
+            graph.markOutput(target);
+            graph.execute(computeCommandBuffer);
+
+            // Release to the graphics family. The matching acquire is recorded at the start of
+            // the graphics command buffer, which waits on the semaphore signaled by this submission.
+            VkImageMemoryBarrier releaseBarrier = {};
+            releaseBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            releaseBarrier.oldLayout = graph.getLayout(target);
+            releaseBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            releaseBarrier.srcQueueFamilyIndex = computeFamily;
+            releaseBarrier.dstQueueFamilyIndex = graphicsFamily;
+            releaseBarrier.image = tagetImage->image;
+            releaseBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            releaseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            releaseBarrier.dstAccessMask = 0;
 
             vkCmdPipelineBarrier(
-                commandBuffers[i],
-                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                computeCommandBuffer,
                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
                 0,
                 0, nullptr,
                 0, nullptr,
-                1, &computeMemoryBarrier);
+                1, &releaseBarrier);
+
+            // In async mode the GPU time covers the compute queue only.
+            if (gpuTimer)
+            {
+                gpuTimer->end(computeCommandBuffer, i);
+            }
 
-            computeModel->computeCommand(commandBuffers[i], i, tagetImage->width / 32, tagetImage->height / 32, 1);
+            if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to record compute command buffer!");
+            }
 
-            VkImageMemoryBarrier screenQuadMemoryBarrier = {};
-            screenQuadMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            screenQuadMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-            screenQuadMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            screenQuadMemoryBarrier.image = tagetImage->image;
-            screenQuadMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-            screenQuadMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-            screenQuadMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to begin recording command buffer!");
+            }
 
+            VkImageMemoryBarrier acquireBarrier = releaseBarrier;
+            acquireBarrier.srcAccessMask = 0;
+            acquireBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            // Source stages match the semaphore wait stages so the acquire runs after the wait.
             vkCmdPipelineBarrier(
                 commandBuffers[i],
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                COMPUTE_HANDOFF_STAGES,
+                COMPUTE_HANDOFF_STAGES,
                 0,
                 0, nullptr,
                 0, nullptr,
-                1, &screenQuadMemoryBarrier);
+                1, &acquireBarrier);
 
-            postProcessScene->writeRenderCommand(commandBuffers[i], i);
-
-            if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+            // Tiles only go to the output file, there is nothing to show.
+            if (!settings.isTiled())
+            {
+                postProcessScene->writeRenderCommand(commandBuffers[i], i, recorder.get());
+            }
+        }
+        else
+        {
+            // Tiles only go to the output file, there is nothing to show.
+            if (!settings.isTiled())
             {
-                throw std::runtime_error("failed to record command buffer!");
+                mcvkp::RenderGraph::Resource swapchainImage = graph.importImage(VulkanGlobal::swapchainContext.swapChainImages[i], mcvkp::ResourceUse{});
+                graph.markOutput(swapchainImage);
+                graph.addPass("post-process", {{target, mcvkp::ResourceUses::sampledFragment}, {swapchainImage, mcvkp::ResourceUses::colorAttachment}},
+                              [this, i](VkCommandBuffer commandBuffer)
+                              { postProcessScene->writeRenderCommand(commandBuffer, i, recorder.get()); });
             }
+            // Sampled by the post-process pass and read back in this layout.
+            graph.exportResource(target, mcvkp::ResourceUses::sampledFragment);
+            graph.execute(commandBuffers[i]);
+        }
+
+        if (gpuTimer && !asyncCompute)
+        {
+            gpuTimer->end(commandBuffers[i], i);
+        }
+
+        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record command buffer!");
         }
     }
 
@@ -217,28 +1331,51 @@ private:
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
+
+        if (!asyncCompute)
+        {
+            return;
+        }
+        computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            if (vkCreateSemaphore(VulkanGlobal::context.device, &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create compute synchronization objects for a frame!");
+            }
+        }
     }
 
     size_t currentFrame = 0;
+    // Offscreen images are used round-robin when there is no swapchain to acquire from.
+    uint32_t nextOffscreenImage = 0;
     void drawFrame()
     {
         vkWaitForFences(VulkanGlobal::context.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(VulkanGlobal::context.device,
-                                                VulkanGlobal::swapchainContext.swapChain,
-                                                UINT64_MAX,
-                                                imageAvailableSemaphores[currentFrame],
-                                                VK_NULL_HANDLE,
-                                                &imageIndex);
-
-        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        if (settings.headless)
         {
-            return;
+            imageIndex = nextOffscreenImage;
+            nextOffscreenImage = (nextOffscreenImage + 1) % VulkanGlobal::swapchainContext.swapChainImages.size();
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        else
         {
-            throw std::runtime_error("failed to acquire swap chain image!");
+            VkResult result = vkAcquireNextImageKHR(VulkanGlobal::context.device,
+                                                    VulkanGlobal::swapchainContext.swapChain,
+                                                    UINT64_MAX,
+                                                    imageAvailableSemaphores[currentFrame],
+                                                    VK_NULL_HANDLE,
+                                                    &imageIndex);
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                return;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
 
         // Check if a previous frame is using this image (i.e. there is its fence to wait on)
@@ -249,28 +1386,102 @@ private:
         // Mark the image as now being in use by this frame
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
+        if (gpuTimer)
+        {
+            collectGpuTime(imageIndex);
+            imageFrameIds[imageIndex] = renderedFrames;
+        }
+
+        // The frame constants are pushed, not read from memory, so every frame records its own
+        // command buffer once the last frame of this image has finished.
+        // The fence also covers the frame that last wrote this frame's region of the arena, and the
+        // frame that last executed the secondary command buffers of this frame's recording pools.
+        frameArena->beginFrame(currentFrame);
+        if (recorder)
+        {
+            recorder->beginFrame(currentFrame);
+        }
         updateScene(imageIndex);
+        recordCommandBuffers(imageIndex);
+        frameArena->flush();
+
+        // Reloaded pipelines are in use from now on, the old ones go once no image records them anymore.
+        if (!staleCommandBuffers.empty())
+        {
+            staleCommandBuffers[imageIndex] = false;
+            if (std::none_of(staleCommandBuffers.begin(), staleCommandBuffers.end(), [](bool stale)
+                             { return stale; }))
+            {
+                for (auto &kernel : reloadableKernels)
+                {
+                    kernel.material->destroyRetiredPipelines();
+                }
+                staleCommandBuffers.clear();
+            }
+        }
         vkResetFences(VulkanGlobal::context.device, 1, &inFlightFences[currentFrame]);
 
+        if (asyncCompute)
+        {
+            submitCompute(imageIndex);
+        }
+
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore renderWaitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = renderWaitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        // Offscreen images are not acquired or presented, so there is nothing to wait on or signal.
+        std::vector<VkSemaphore> renderWaitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        if (!settings.headless)
+        {
+            renderWaitSemaphores.push_back(imageAvailableSemaphores[currentFrame]);
+            waitStages.push_back(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        }
+        if (asyncCompute)
+        {
+            renderWaitSemaphores.push_back(computeFinishedSemaphores[currentFrame]);
+            waitStages.push_back(COMPUTE_HANDOFF_STAGES);
+        }
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(renderWaitSemaphores.size());
+        submitInfo.pWaitSemaphores = renderWaitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
         VkSemaphore renderSignalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = settings.headless ? 0 : 1;
         submitInfo.pSignalSemaphores = renderSignalSemaphores;
 
-        if (vkQueueSubmit(VulkanGlobal::context.graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        // With async compute the frame fence goes on the release submission below, after the readback.
+        VkFence drawFence = asyncCompute ? VK_NULL_HANDLE : inFlightFences[currentFrame];
+        if (vkQueueSubmit(VulkanGlobal::context.graphicsQueue, 1, &submitInfo, drawFence) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+
+        if (readbackRing)
+        {
+            // Same queue, so the copy runs after this frame's compute dispatch.
+            auto targetImage = targetImages->images[imageIndex];
+            readbackRing->enqueue(*targetImage,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  renderedFrames);
+            readbackRing->poll();
+        }
+
+        if (asyncCompute)
+        {
+            signalFrameFence();
+        }
+
+        if (settings.headless)
+        {
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return;
+        }
+
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -282,7 +1493,7 @@ private:
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr;
 
-        result = vkQueuePresentKHR(VulkanGlobal::context.presentQueue, &presentInfo);
+        VkResult result = vkQueuePresentKHR(VulkanGlobal::context.presentQueue, &presentInfo);
 
         if (result != VK_SUCCESS)
         {
@@ -294,39 +1505,268 @@ private:
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
 
+    // Starts rebuilding every kernel when a shader source changed and swaps in the pipelines that
+    // are built. Never waits for a build, the frames keep the old pipelines until then.
+    void reloadShaders()
+    {
+        if (shaderWatcher->poll())
+        {
+            std::cout << "Reloading shaders\n";
+            for (auto &kernel : reloadableKernels)
+            {
+                kernel.material->reload(loadKernel(kernel.name, kernel.defines));
+            }
+        }
+
+        bool swapped = false;
+        for (auto &kernel : reloadableKernels)
+        {
+            swapped = kernel.material->swapPipeline() || swapped;
+        }
+        if (swapped)
+        {
+            staleCommandBuffers.assign(commandBuffers.size(), true);
+        }
+    }
+
+    // Records the GPU time of the last frame rendered with imageIndex, its fence must have signaled.
+    void collectGpuTime(uint32_t imageIndex)
+    {
+        int64_t frameId = imageFrameIds[imageIndex];
+        imageFrameIds[imageIndex] = -1;
+        if (frameId < 0)
+        {
+            return;
+        }
+        double milliseconds = gpuTimer->getMilliseconds(imageIndex);
+        if (resolutionGovernor)
+        {
+            resolutionGovernor->addFrameTime(static_cast<float>(milliseconds));
+        }
+        if (settings.benchmark && frameId >= static_cast<int64_t>(settings.warmupFrames))
+        {
+            gpuFrameTimes.add(milliseconds);
+        }
+    }
+
+    void writeBenchmarkReport()
+    {
+        std::ofstream file(settings.reportFile);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open benchmark report!");
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &properties);
+        auto targetImage = targetImages->images[0];
+
+        file << "{\n"
+             << "  \"device\": \"" << properties.deviceName << "\",\n"
+             << "  \"driver_version\": " << properties.driverVersion << ",\n"
+             << "  \"width\": " << targetImage->width << ",\n"
+             << "  \"height\": " << targetImage->height << ",\n"
+             << "  \"headless\": " << (settings.headless ? "true" : "false") << ",\n"
+             << "  \"warmup_frames\": " << settings.warmupFrames << ",\n"
+             << "  \"frames\": " << cpuFrameTimes.size() << ",\n"
+             << "  \"timestep\": " << settings.timestep << ",\n"
+             << "  \"cpu_frame_ms\": ";
+        cpuFrameTimes.writeJson(file);
+        file << ",\n"
+             << "  \"gpu_ms\": ";
+        gpuFrameTimes.writeJson(file);
+        file << "\n}\n";
+        std::cout << "Wrote benchmark report to " << settings.reportFile << "\n";
+    }
+
+    // Runs the compute dispatch on the compute queue, signaling this frame's graphics submission.
+    // Every frame has its own target, so it can overlap the previous frame's graphics work.
+    void submitCompute(uint32_t imageIndex)
+    {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &computeCommandBuffers[imageIndex];
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+
+        if (vkQueueSubmit(VulkanGlobal::context.computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit compute command buffer!");
+        }
+    }
+
+    // Empty graphics submission after the draw and the readback copy. Its fence marks the whole
+    // frame as done, so the compute queue may write the frame's target again once it signaled.
+    void signalFrameFence()
+    {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        if (vkQueueSubmit(VulkanGlobal::context.graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit frame fence!");
+        }
+    }
+
+    bool shouldClose()
+    {
+        if (settings.totalFrames() > 0 && renderedFrames >= settings.totalFrames())
+        {
+            return true;
+        }
+        return !settings.headless && glfwWindowShouldClose(VulkanGlobal::context.window);
+    }
+
     int nbFrames = 0;
     float lastTime = 0;
+    uint32_t renderedFrames = 0;
     void mainLoop()
     {
-        while (!glfwWindowShouldClose(VulkanGlobal::context.window))
+        while (!shouldClose())
         {
-            float currentTime = (float)glfwGetTime();
+            float currentTime = getTime();
             deltaTime = currentTime - lastFrame;
             nbFrames++;
-            if (currentTime - lastTime >= 1.0)
+            if (!settings.benchmark && currentTime - lastTime >= 1.0)
             { // If last prinf() was more than 1 sec ago
                 // printf and reset timer
-                printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+                if (resolutionGovernor)
+                {
+                    printf("%f ms/frame, render scale %.2f\n", 1000.0 / double(nbFrames), resolutionGovernor->getScale());
+                }
+                else
+                {
+                    printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+                }
                 nbFrames = 0;
                 lastTime = currentTime;
             }
             lastFrame = currentTime;
 
-            processInput(VulkanGlobal::context.window);
-            glfwPollEvents();
+            if (!settings.headless)
+            {
+                // The camera stays put during benchmarks.
+                if (!settings.benchmark)
+                {
+                    processInput(VulkanGlobal::context.window);
+                }
+                glfwPollEvents();
+            }
+            if (shaderWatcher)
+            {
+                reloadShaders();
+            }
+            auto frameStart = std::chrono::steady_clock::now();
             drawFrame();
+            if (settings.benchmark && renderedFrames >= settings.warmupFrames)
+            {
+                std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                cpuFrameTimes.add(frameTime.count());
+            }
+            renderedFrames++;
         }
 
         vkDeviceWaitIdle(VulkanGlobal::context.device);
+        if (gpuTimer)
+        {
+            for (uint32_t i = 0; i < imageFrameIds.size(); i++)
+            {
+                collectGpuTime(i);
+            }
+        }
+        if (readbackRing)
+        {
+            readbackRing->flush();
+        }
+        float totalTime = getTime();
+        std::cout << "Rendered " << renderedFrames << " frames in " << totalTime << " s\n";
+        if (readbackRing)
+        {
+            std::cout << "Read back " << readbackFrames << " frames, " << readbackFrames / totalTime << " frames/s\n";
+        }
+        if (settings.benchmark)
+        {
+            writeBenchmarkReport();
+        }
+    }
+
+    std::vector<mcvkp::ViewParams> loadSweep(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open sweep file!");
+        }
+
+        std::vector<mcvkp::ViewParams> views;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            mcvkp::ViewParams view{};
+            if (sscanf(line.c_str(), "%f %f %f %f", &view.camPosition.x, &view.camPosition.y, &view.camPosition.z, &view.time) != 4)
+            {
+                throw std::runtime_error("malformed sweep line: " + line);
+            }
+            views.push_back(view);
+        }
+        return views;
+    }
+
+    // Renders every view of the sweep file, settings.batchSize views per submission.
+    void runSweep()
+    {
+        std::vector<mcvkp::ViewParams> views = loadSweep(settings.sweepFile);
+
+        // Two batches in flight while the third is consumed, like the frame readback ring.
+        mcvkp::BatchRenderer batchRenderer(settings.offscreenExtent.width,
+                                           settings.offscreenExtent.height,
+                                           settings.batchSize,
+                                           std::max<uint32_t>(settings.readbackSlots, 3),
+                                           path_prefix + "/shaders/generated/mandelbrot-batch.spv",
+                                           [this](const mcvkp::ReadbackFrame &frame)
+                                           { consumeFrame(frame); });
+
+        float begin = getTime();
+        batchRenderer.render(views);
+        float totalTime = getTime() - begin;
+        std::cout << "Rendered " << views.size() << " views in " << totalTime << " s, "
+                  << views.size() / totalTime << " views/s\n";
     }
 
     void initVulkan()
     {
         initScene();
 
+        // The governor needs the GPU time of every frame too.
+        if (settings.benchmark || resolutionGovernor)
+        {
+            uint32_t numImages = static_cast<uint32_t>(VulkanGlobal::swapchainContext.swapChainImages.size());
+            // The timer starts in the compute command buffer, which is the graphics one without a dedicated compute queue.
+            gpuTimer = std::make_shared<mcvkp::GpuTimer>(numImages, VulkanGlobal::context.queueFamilyIndices.computeFamily.value());
+            imageFrameIds.assign(numImages, -1);
+            // The report then has no GPU times instead of zeros.
+            if (!gpuTimer->isSupported())
+            {
+                gpuTimer.reset();
+                if (resolutionGovernor)
+                {
+                    std::cout << "No timestamp support, rendering at full resolution\n";
+                    resolutionGovernor.reset();
+                }
+            }
+        }
+
         createCommandBuffers();
         createSyncObjects();
-        glfwSetCursorPosCallback(VulkanGlobal::context.window, mouse_callback);
+        if (!settings.headless)
+        {
+            glfwSetCursorPosCallback(VulkanGlobal::context.window, mouse_callback);
+        }
     }
 
     void cleanup()
@@ -337,17 +1777,28 @@ private:
             vkDestroySemaphore(VulkanGlobal::context.device, imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(VulkanGlobal::context.device, inFlightFences[i], nullptr);
         }
+        for (size_t i = 0; i < computeFinishedSemaphores.size(); i++)
+        {
+            vkDestroySemaphore(VulkanGlobal::context.device, computeFinishedSemaphores[i], nullptr);
+        }
 
-        glfwTerminate();
+        if (!settings.headless)
+        {
+            glfwTerminate();
+        }
     }
 };
 
-int main()
+int main(int argc, char **argv)
 {
-    HelloComputeApplication app;
-
     try
     {
+        AppSettings settings = parseArguments(argc, argv);
+        VulkanGlobal::context.init(settings.headless, settings.asyncCompute);
+        VulkanGlobal::context.createPipelineCache(settings.pipelineCachePath);
+        VulkanGlobal::swapchainContext.init(settings.offscreenExtent);
+
+        HelloComputeApplication app(settings);
         app.run();
     }
     catch (const std::exception &e)
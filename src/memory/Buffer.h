@@ -12,9 +12,11 @@ namespace mcvkp
 {
     struct Buffer
     {
-        VkBuffer buffer;
+        VkBuffer buffer = VK_NULL_HANDLE;
         VmaAllocation allocation;
         VkDeviceSize size;
+        // Only set for persistently mapped allocations.
+        void *mappedData = nullptr;
 
         ~Buffer()
         {
@@ -55,7 +57,8 @@ namespace mcvkp
         void inline allocate(Buffer *buffer,
                              VkDeviceSize size,
                              VkBufferUsageFlags usage,
-                             VmaMemoryUsage memoryUsage)
+                             VmaMemoryUsage memoryUsage,
+                             VmaAllocationCreateFlags allocationFlags = 0)
         {
             VkBufferCreateInfo bufferInfo{};
             bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -65,16 +68,20 @@ namespace mcvkp
 
             VmaAllocationCreateInfo vmaallocInfo = {};
             vmaallocInfo.usage = memoryUsage;
+            vmaallocInfo.flags = allocationFlags;
 
+            VmaAllocationInfo allocationInfo = {};
             if (vmaCreateBuffer(VulkanGlobal::context.allocator,
                                 &bufferInfo,
                                 &vmaallocInfo,
                                 &buffer->buffer,
                                 &buffer->allocation,
-                                nullptr) != VK_SUCCESS)
+                                &allocationInfo) != VK_SUCCESS)
             {
                 throw std::runtime_error("failed to create buffer");
             }
+            // Non-null only with VMA_ALLOCATION_CREATE_MAPPED_BIT.
+            buffer->mappedData = allocationInfo.pMappedData;
         }
 
         template <typename T>
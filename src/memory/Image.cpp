@@ -21,7 +21,11 @@ namespace mcvkp
         {
             vkDestroyImageView(VulkanGlobal::context.device, imageView, nullptr);
             vkDestroyImage(VulkanGlobal::context.device, image, nullptr);
-            vmaFreeMemory(VulkanGlobal::context.allocator, allocation);
+            if (allocation != VK_NULL_HANDLE)
+            {
+                vmaFreeMemory(VulkanGlobal::context.allocator, allocation);
+                allocation = VK_NULL_HANDLE;
+            }
 
             image = VK_NULL_HANDLE;
         }
@@ -42,18 +46,20 @@ namespace mcvkp
         VkImageView createImageView(VkImage &image,
                                     VkFormat format,
                                     VkImageAspectFlags aspectFlags,
-                                    const uint32_t &mipLevels)
+                                    const uint32_t &mipLevels,
+                                    VkImageViewType viewType,
+                                    uint32_t layerCount)
         {
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             viewInfo.image = image;
-            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.viewType = viewType;
             viewInfo.format = format;
             viewInfo.subresourceRange.aspectMask = aspectFlags;
             viewInfo.subresourceRange.baseMipLevel = 0;
             viewInfo.subresourceRange.levelCount = mipLevels;
             viewInfo.subresourceRange.baseArrayLayer = 0;
-            viewInfo.subresourceRange.layerCount = 1;
+            viewInfo.subresourceRange.layerCount = layerCount;
 
             VkImageView imageView;
             if (vkCreateImageView(VulkanGlobal::context.device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
@@ -64,6 +70,24 @@ namespace mcvkp
             return imageView;
         }
 
+        void allocateImage(const VkImageCreateInfo &imageInfo,
+                           VmaMemoryUsage memoryUsage,
+                           std::shared_ptr<Image> allocatedImage)
+        {
+            VmaAllocationCreateInfo vmaallocInfo = {};
+            vmaallocInfo.usage = memoryUsage;
+
+            if (vmaCreateImage(VulkanGlobal::context.allocator,
+                               &imageInfo,
+                               &vmaallocInfo,
+                               &allocatedImage->image,
+                               &allocatedImage->allocation,
+                               nullptr) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create buffer");
+            }
+        }
+
         void createImage(uint32_t width,
                          uint32_t height,
                          uint32_t mipLevels,
@@ -93,29 +117,92 @@ namespace mcvkp
             imageInfo.samples = numSamples;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-            VmaAllocationCreateInfo vmaallocInfo = {};
-            vmaallocInfo.usage = memoryUsage;
-
-            if (vmaCreateImage(VulkanGlobal::context.allocator,
-                               &imageInfo,
-                               &vmaallocInfo,
-                               &allocatedImage->image,
-                               &allocatedImage->allocation,
-                               nullptr) != VK_SUCCESS)
-            {
-                throw std::runtime_error("failed to create buffer");
-            }
+            allocateImage(imageInfo, memoryUsage, allocatedImage);
             allocatedImage->imageView = createImageView(allocatedImage->image,
                                                         format,
                                                         aspectFlags,
                                                         mipLevels);
         }
 
+        void createImageArray(uint32_t width,
+                              uint32_t height,
+                              uint32_t layers,
+                              VkFormat format,
+                              VkImageUsageFlags usage,
+                              VkImageAspectFlags aspectFlags,
+                              VmaMemoryUsage memoryUsage,
+                              std::shared_ptr<Image> allocatedImage)
+        {
+            allocatedImage->width = width;
+            allocatedImage->height = height;
+            allocatedImage->layers = layers;
+
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = width;
+            imageInfo.extent.height = height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = layers;
+            imageInfo.format = format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            allocateImage(imageInfo, memoryUsage, allocatedImage);
+            allocatedImage->imageView = createImageView(allocatedImage->image,
+                                                        format,
+                                                        aspectFlags,
+                                                        1,
+                                                        VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                                                        layers);
+        }
+
+        void createImage3D(uint32_t width,
+                           uint32_t height,
+                           uint32_t depth,
+                           VkFormat format,
+                           VkImageUsageFlags usage,
+                           VkImageAspectFlags aspectFlags,
+                           VmaMemoryUsage memoryUsage,
+                           std::shared_ptr<Image> allocatedImage)
+        {
+            allocatedImage->width = width;
+            allocatedImage->height = height;
+            allocatedImage->depth = depth;
+
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_3D;
+            imageInfo.extent.width = width;
+            imageInfo.extent.height = height;
+            imageInfo.extent.depth = depth;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            allocateImage(imageInfo, memoryUsage, allocatedImage);
+            allocatedImage->imageView = createImageView(allocatedImage->image,
+                                                        format,
+                                                        aspectFlags,
+                                                        1,
+                                                        VK_IMAGE_VIEW_TYPE_3D);
+        }
+
         void transitionImageLayout(VkImage image,
                                    VkFormat format,
                                    VkImageLayout oldLayout,
                                    VkImageLayout newLayout,
-                                   const uint32_t &mipLevels)
+                                   const uint32_t &mipLevels,
+                                   uint32_t layerCount)
         {
             VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
             VkImageMemoryBarrier barrier{};
@@ -129,7 +216,7 @@ namespace mcvkp
             barrier.subresourceRange.baseMipLevel = 0;
             barrier.subresourceRange.levelCount = mipLevels;
             barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = 1;
+            barrier.subresourceRange.layerCount = layerCount;
 
             VkPipelineStageFlags sourceStage;
             VkPipelineStageFlags destinationStage;
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 #include "vk_mem_alloc.h"
 
 namespace mcvkp
@@ -11,23 +12,42 @@ namespace mcvkp
     class Image
     {
     public:
-        VkImage image;
-        VmaAllocation allocation;
-        VkImageView imageView;
+        VkImage image = VK_NULL_HANDLE;
+        // VK_NULL_HANDLE when the image is bound to memory it doesn't own, see TransientImagePool.
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
         uint32_t width;
         uint32_t height;
+        uint32_t layers = 1;
+        uint32_t depth = 1;
 
         ~Image();
         void destroy();
         VkDescriptorImageInfo getDescriptorInfo(VkImageLayout imageLayout);
     };
 
+    // One image per swapchain image, so frames in flight never write the same image.
+    struct ImageBundle
+    {
+        std::vector<std::shared_ptr<Image> > images;
+
+        ImageBundle(size_t numImages)
+        {
+            for (size_t i = 0; i < numImages; i++)
+            {
+                images.push_back(std::make_shared<Image>());
+            }
+        }
+    };
+
     namespace ImageUtils
     {
         VkImageView createImageView(VkImage &image,
                                     VkFormat format,
                                     VkImageAspectFlags aspectFlags,
-                                    const uint32_t &mipLevels);
+                                    const uint32_t &mipLevels,
+                                    VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D,
+                                    uint32_t layerCount = 1);
 
         void createImage(uint32_t width,
                          uint32_t height,
@@ -40,11 +60,32 @@ namespace mcvkp
                          VmaMemoryUsage memoryUsage,
                          std::shared_ptr<Image> allocatedImage);
 
+        // 2D image with a 2D array view, used to render several views in one dispatch.
+        void createImageArray(uint32_t width,
+                              uint32_t height,
+                              uint32_t layers,
+                              VkFormat format,
+                              VkImageUsageFlags usage,
+                              VkImageAspectFlags aspectFlags,
+                              VmaMemoryUsage memoryUsage,
+                              std::shared_ptr<Image> allocatedImage);
+
+        // 3D image with a 3D view, for volumes sampled or written by compute kernels.
+        void createImage3D(uint32_t width,
+                           uint32_t height,
+                           uint32_t depth,
+                           VkFormat format,
+                           VkImageUsageFlags usage,
+                           VkImageAspectFlags aspectFlags,
+                           VmaMemoryUsage memoryUsage,
+                           std::shared_ptr<Image> allocatedImage);
+
         void transitionImageLayout(VkImage image,
                                    VkFormat format,
                                    VkImageLayout oldLayout,
                                    VkImageLayout newLayout,
-                                   const uint32_t &mipLevels);
+                                   const uint32_t &mipLevels,
+                                   uint32_t layerCount = 1);
 
         void copyBufferToImage(const VkBuffer &buffer, VkImage image, uint32_t width, uint32_t height);
 
@@ -78,4 +119,20 @@ namespace mcvkp
         std::shared_ptr<VkSampler> m_sampler;
         uint32_t m_mips = 1;
     };
+
+    // Samples the images of an ImageBundle, one texture per swapchain image.
+    struct TextureBundle
+    {
+        std::vector<std::shared_ptr<Texture> > textures;
+
+        TextureBundle() {}
+
+        TextureBundle(const ImageBundle &imageBundle)
+        {
+            for (auto &image : imageBundle.images)
+            {
+                textures.push_back(std::make_shared<Texture>(image));
+            }
+        }
+    };
 }
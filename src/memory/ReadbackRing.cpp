@@ -0,0 +1,265 @@
+#include <iostream>
+#include <stdexcept>
+#include "ReadbackRing.h"
+
+namespace mcvkp
+{
+    ReadbackRing::ReadbackRing(size_t numSlots,
+                               uint32_t width,
+                               uint32_t height,
+                               uint32_t bytesPerPixel,
+                               Consumer consumer,
+                               uint32_t maxLayers) : m_width(width), m_height(height), m_bytesPerPixel(bytesPerPixel), m_maxLayers(maxLayers), m_consumer(consumer)
+    {
+        if (numSlots == 0)
+        {
+            throw std::invalid_argument("readback ring needs at least one slot!");
+        }
+        if (maxLayers == 0)
+        {
+            throw std::invalid_argument("readback ring needs at least one layer per slot!");
+        }
+
+        // Command buffers are re-recorded every time their slot is reused.
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = VulkanGlobal::context.queueFamilyIndices.graphicsFamily.value();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(VulkanGlobal::context.device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create readback command pool!");
+        }
+
+        std::vector<VkCommandBuffer> commandBuffers(numSlots);
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(numSlots);
+        if (vkAllocateCommandBuffers(VulkanGlobal::context.device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate readback command buffers!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkDeviceSize slotSize = static_cast<VkDeviceSize>(width) * height * bytesPerPixel * maxLayers;
+        m_slots.resize(numSlots);
+        for (size_t i = 0; i < numSlots; i++)
+        {
+            Slot &slot = m_slots[i];
+            slot.commandBuffer = commandBuffers[i];
+            slot.buffer = std::make_shared<Buffer>();
+            slot.buffer->size = slotSize;
+            BufferUtils::allocate(slot.buffer.get(),
+                                  slotSize,
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                  VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+            if (vkCreateFence(VulkanGlobal::context.device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create readback fence!");
+            }
+        }
+    }
+
+    ReadbackRing::~ReadbackRing()
+    {
+        std::cout << "Destroying readback ring"
+                  << "\n";
+        // Pending copies are dropped, the consumer may already be gone.
+        for (auto &slot : m_slots)
+        {
+            if (slot.pending)
+            {
+                vkWaitForFences(VulkanGlobal::context.device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            }
+            vkDestroyFence(VulkanGlobal::context.device, slot.fence, nullptr);
+        }
+        vkDestroyCommandPool(VulkanGlobal::context.device, m_commandPool, nullptr);
+    }
+
+    void ReadbackRing::enqueue(const Image &image,
+                               VkImageLayout imageLayout,
+                               VkPipelineStageFlags srcStageMask,
+                               VkAccessFlags srcAccessMask,
+                               uint64_t frameId)
+    {
+        size_t slotIndex = acquire(frameId);
+        Slot &slot = m_slots[slotIndex];
+        vkResetCommandBuffer(slot.commandBuffer, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording readback command buffer!");
+        }
+
+        recordCopy(slot.commandBuffer, slotIndex, image, imageLayout, srcStageMask, srcAccessMask);
+
+        if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record readback command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+        if (vkQueueSubmit(VulkanGlobal::context.graphicsQueue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit readback command buffer!");
+        }
+    }
+
+    size_t ReadbackRing::acquire(uint64_t frameId)
+    {
+        size_t slotIndex = m_nextSlot;
+        Slot &slot = m_slots[slotIndex];
+        if (slot.pending)
+        {
+            // Every slot is in flight, the oldest one has to be drained before it can be reused.
+            vkWaitForFences(VulkanGlobal::context.device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            __deliver(slot);
+        }
+        vkResetFences(VulkanGlobal::context.device, 1, &slot.fence);
+
+        slot.pending = true;
+        slot.frameId = frameId;
+        slot.layers = 1;
+        m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+        return slotIndex;
+    }
+
+    void ReadbackRing::recordCopy(VkCommandBuffer commandBuffer,
+                                  size_t slotIndex,
+                                  const Image &image,
+                                  VkImageLayout imageLayout,
+                                  VkPipelineStageFlags srcStageMask,
+                                  VkAccessFlags srcAccessMask,
+                                  uint32_t layerCount)
+    {
+        if (layerCount == 0 || layerCount > m_maxLayers)
+        {
+            throw std::invalid_argument("readback layer count does not fit the slot!");
+        }
+        Slot &slot = m_slots[slotIndex];
+        slot.layers = layerCount;
+
+        VkImageMemoryBarrier toTransferBarrier{};
+        toTransferBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransferBarrier.oldLayout = imageLayout;
+        toTransferBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toTransferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransferBarrier.image = image.image;
+        toTransferBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount};
+        toTransferBarrier.srcAccessMask = srcAccessMask;
+        toTransferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             srcStageMask,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &toTransferBarrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        // Layers land one after another in the buffer.
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layerCount};
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {m_width, m_height, 1};
+
+        vkCmdCopyImageToBuffer(commandBuffer,
+                               image.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               slot.buffer->buffer,
+                               1,
+                               &region);
+
+        // Give the image back in the layout the frame expects. Anything after this has to wait
+        // for the copy to finish reading before it touches the image again.
+        VkImageMemoryBarrier restoreBarrier = toTransferBarrier;
+        restoreBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        restoreBarrier.newLayout = imageLayout;
+        restoreBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        restoreBarrier.dstAccessMask = 0;
+
+        VkBufferMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.buffer = slot.buffer->buffer;
+        hostBarrier.offset = 0;
+        hostBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                             0,
+                             0, nullptr,
+                             1, &hostBarrier,
+                             1, &restoreBarrier);
+    }
+
+    void ReadbackRing::poll()
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            Slot &slot = m_slots[(m_nextSlot + i) % m_slots.size()];
+            if (!slot.pending)
+            {
+                continue;
+            }
+            // Stop at the first copy still in flight to keep frames in order.
+            if (vkGetFenceStatus(VulkanGlobal::context.device, slot.fence) != VK_SUCCESS)
+            {
+                return;
+            }
+            __deliver(slot);
+        }
+    }
+
+    void ReadbackRing::flush()
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            Slot &slot = m_slots[(m_nextSlot + i) % m_slots.size()];
+            if (!slot.pending)
+            {
+                continue;
+            }
+            vkWaitForFences(VulkanGlobal::context.device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            __deliver(slot);
+        }
+    }
+
+    void ReadbackRing::__deliver(Slot &slot)
+    {
+        // GPU_TO_CPU memory is not guaranteed to be host coherent.
+        vmaInvalidateAllocation(VulkanGlobal::context.allocator, slot.buffer->allocation, 0, VK_WHOLE_SIZE);
+
+        ReadbackFrame frame{};
+        frame.frameId = slot.frameId;
+        frame.width = m_width;
+        frame.height = m_height;
+        frame.layers = slot.layers;
+        frame.rowPitch = static_cast<VkDeviceSize>(m_width) * m_bytesPerPixel;
+        frame.layerPitch = frame.rowPitch * m_height;
+        frame.data = slot.buffer->mappedData;
+        m_consumer(frame);
+
+        slot.pending = false;
+    }
+}
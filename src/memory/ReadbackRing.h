@@ -0,0 +1,101 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "Buffer.h"
+#include "Image.h"
+
+namespace mcvkp
+{
+    // A finished readback, valid only for the duration of the consumer call.
+    struct ReadbackFrame
+    {
+        uint64_t frameId;
+        uint32_t width;
+        uint32_t height;
+        // Number of array layers in data, each layerPitch bytes apart.
+        uint32_t layers;
+        // Rows and layers are tightly packed.
+        VkDeviceSize rowPitch;
+        VkDeviceSize layerPitch;
+        const void *data;
+    };
+
+    // Copies images into a ring of persistently mapped host buffers.
+    // Every copy signals its own fence and the consumer is called once the fence has signaled,
+    // usually a few frames later, so the GPU never waits for the CPU to drain a frame.
+    // The CPU only blocks when all slots are still in flight.
+    class ReadbackRing
+    {
+    public:
+        using Consumer = std::function<void(const ReadbackFrame &frame)>;
+
+        // Every slot holds up to maxLayers array layers of width x height.
+        ReadbackRing(size_t numSlots,
+                     uint32_t width,
+                     uint32_t height,
+                     uint32_t bytesPerPixel,
+                     Consumer consumer,
+                     uint32_t maxLayers = 1);
+
+        ~ReadbackRing();
+
+        // Records and submits a copy of the image into the next slot. Must be called after the
+        // submission that wrote the image; the image is returned to imageLayout afterwards.
+        void enqueue(const Image &image,
+                     VkImageLayout imageLayout,
+                     VkPipelineStageFlags srcStageMask,
+                     VkAccessFlags srcAccessMask,
+                     uint64_t frameId);
+
+        // Reserves the next slot for a copy recorded into the caller's command buffer. The caller
+        // has to record it with recordCopy and submit that command buffer with getFence(slot),
+        // otherwise poll and flush never see the slot finish.
+        size_t acquire(uint64_t frameId);
+
+        // Records a copy of the first layerCount layers of the image into the slot.
+        void recordCopy(VkCommandBuffer commandBuffer,
+                        size_t slot,
+                        const Image &image,
+                        VkImageLayout imageLayout,
+                        VkPipelineStageFlags srcStageMask,
+                        VkAccessFlags srcAccessMask,
+                        uint32_t layerCount = 1);
+
+        VkFence getFence(size_t slot) const { return m_slots[slot].fence; }
+
+        // Hands completed slots to the consumer in submission order, without blocking.
+        void poll();
+
+        // Waits for every pending copy and hands it to the consumer.
+        void flush();
+
+    private:
+        struct Slot
+        {
+            std::shared_ptr<Buffer> buffer;
+            VkCommandBuffer commandBuffer;
+            VkFence fence;
+            bool pending = false;
+            uint64_t frameId = 0;
+            uint32_t layers = 1;
+        };
+
+        void __deliver(Slot &slot);
+
+        std::vector<Slot> m_slots;
+        // Slots are used round-robin, so the next slot is also the oldest pending one.
+        size_t m_nextSlot = 0;
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_bytesPerPixel;
+        uint32_t m_maxLayers;
+        Consumer m_consumer;
+
+        VkCommandPool m_commandPool;
+    };
+}
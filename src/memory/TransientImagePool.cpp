@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include "TransientImagePool.h"
+
+namespace mcvkp
+{
+    TransientImagePool::~TransientImagePool()
+    {
+        destroy();
+    }
+
+    std::shared_ptr<Image> TransientImagePool::declare(uint32_t width,
+                                                       uint32_t height,
+                                                       VkFormat format,
+                                                       VkImageUsageFlags usage,
+                                                       VkImageAspectFlags aspectFlags,
+                                                       uint32_t firstPass,
+                                                       uint32_t lastPass)
+    {
+        if (m_allocation != VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("failed to declare transient image, the pool is already allocated!");
+        }
+        if (firstPass > lastPass)
+        {
+            throw std::invalid_argument("transient image is used in its last pass before its first!");
+        }
+
+        Entry entry{};
+        entry.image = std::make_shared<Image>();
+        entry.image->width = width;
+        entry.image->height = height;
+        // No allocation of its own, the memory belongs to the pool.
+        entry.format = format;
+        entry.aspectFlags = aspectFlags;
+        entry.firstPass = firstPass;
+        entry.lastPass = lastPass;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(VulkanGlobal::context.device, &imageInfo, nullptr, &entry.image->image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create transient image!");
+        }
+        vkGetImageMemoryRequirements(VulkanGlobal::context.device, entry.image->image, &entry.requirements);
+
+        m_entries.push_back(entry);
+        return entry.image;
+    }
+
+    void TransientImagePool::allocate()
+    {
+        if (m_allocation != VK_NULL_HANDLE || m_entries.empty())
+        {
+            return;
+        }
+
+        VkMemoryRequirements requirements{};
+        requirements.alignment = 1;
+        requirements.memoryTypeBits = ~0u;
+        for (const Entry &entry : m_entries)
+        {
+            requirements.alignment = std::max(requirements.alignment, entry.requirements.alignment);
+            requirements.memoryTypeBits &= entry.requirements.memoryTypeBits;
+        }
+        if (requirements.memoryTypeBits == 0)
+        {
+            throw std::runtime_error("failed to allocate transient images, they have no memory type in common!");
+        }
+
+        // Largest first, each at the lowest offset that doesn't overlap an image alive in one of its passes.
+        std::vector<size_t> order(m_entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+                         { return m_entries[a].requirements.size > m_entries[b].requirements.size; });
+        std::vector<size_t> placed;
+        for (size_t index : order)
+        {
+            Entry &entry = m_entries[index];
+            std::vector<const Entry *> alive;
+            for (size_t other : placed)
+            {
+                const Entry &otherEntry = m_entries[other];
+                if (otherEntry.firstPass <= entry.lastPass && entry.firstPass <= otherEntry.lastPass)
+                {
+                    alive.push_back(&otherEntry);
+                }
+            }
+
+            VkDeviceSize alignment = entry.requirements.alignment;
+            std::vector<VkDeviceSize> candidates = {0};
+            for (const Entry *other : alive)
+            {
+                VkDeviceSize end = other->offset + other->requirements.size;
+                candidates.push_back((end + alignment - 1) / alignment * alignment);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            for (VkDeviceSize candidate : candidates)
+            {
+                bool fits = std::none_of(alive.begin(), alive.end(), [&](const Entry *other)
+                                         { return candidate < other->offset + other->requirements.size &&
+                                                  other->offset < candidate + entry.requirements.size; });
+                if (fits)
+                {
+                    entry.offset = candidate;
+                    break;
+                }
+            }
+            requirements.size = std::max(requirements.size, entry.offset + entry.requirements.size);
+            placed.push_back(index);
+        }
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        if (vmaAllocateMemory(VulkanGlobal::context.allocator, &requirements, &allocInfo, &m_allocation, nullptr) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate transient image memory!");
+        }
+        m_size = requirements.size;
+
+        for (Entry &entry : m_entries)
+        {
+            if (vmaBindImageMemory2(VulkanGlobal::context.allocator, m_allocation, entry.offset, entry.image->image, nullptr) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to bind transient image memory!");
+            }
+            entry.image->imageView = ImageUtils::createImageView(entry.image->image, entry.format, entry.aspectFlags, 1);
+        }
+    }
+
+    std::vector<VkImage> TransientImagePool::getAliasedBefore(const std::shared_ptr<Image> &image) const
+    {
+        const Entry &entry = __find(image);
+        std::vector<VkImage> aliased;
+        for (const Entry &other : m_entries)
+        {
+            bool sharesMemory = other.offset < entry.offset + entry.requirements.size &&
+                                entry.offset < other.offset + other.requirements.size;
+            if (sharesMemory && other.lastPass < entry.firstPass)
+            {
+                aliased.push_back(other.image->image);
+            }
+        }
+        return aliased;
+    }
+
+    void TransientImagePool::destroy()
+    {
+        if (m_allocation != VK_NULL_HANDLE)
+        {
+            vmaFreeMemory(VulkanGlobal::context.allocator, m_allocation);
+            m_allocation = VK_NULL_HANDLE;
+            m_size = 0;
+        }
+    }
+
+    const TransientImagePool::Entry &TransientImagePool::__find(const std::shared_ptr<Image> &image) const
+    {
+        auto entry = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry &other)
+                                  { return other.image == image; });
+        if (entry == m_entries.end())
+        {
+            throw std::invalid_argument("image wasn't declared in this transient image pool!");
+        }
+        return *entry;
+    }
+}
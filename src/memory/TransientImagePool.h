@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "Image.h"
+
+namespace mcvkp
+{
+    // Images whose contents only live from one pass of a frame to a later pass of the same frame.
+    // Each is declared with the first and last pass it is used in, in the order the caller gives the
+    // passes of a frame. All of them are bound to one allocation, and images with no pass in common
+    // share memory, so a chain of intermediate images only needs room for the ones alive at once.
+    // The contents are gone at the start of every frame. Import the images into the render graph with a
+    // last use in VK_IMAGE_LAYOUT_UNDEFINED, whose stages cover everything the frame before did with the
+    // pool's memory, and alias them with getAliasedBefore.
+    class TransientImagePool
+    {
+    public:
+        ~TransientImagePool();
+
+        // Creates a 2D image, bound to memory by allocate.
+        std::shared_ptr<Image> declare(uint32_t width,
+                                       uint32_t height,
+                                       VkFormat format,
+                                       VkImageUsageFlags usage,
+                                       VkImageAspectFlags aspectFlags,
+                                       uint32_t firstPass,
+                                       uint32_t lastPass);
+
+        // Places every declared image in one allocation and creates their views. Called once, after the last declare.
+        void allocate();
+
+        // Images the frame is done with before the first pass of image, whose memory image reuses.
+        std::vector<VkImage> getAliasedBefore(const std::shared_ptr<Image> &image) const;
+
+        // Bytes of the shared allocation, 0 before allocate.
+        VkDeviceSize getSize() const { return m_size; }
+
+        // Also run by the destructor. The images must not be used afterwards.
+        void destroy();
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Image> image;
+            VkFormat format;
+            VkImageAspectFlags aspectFlags;
+            uint32_t firstPass;
+            uint32_t lastPass;
+            VkMemoryRequirements requirements;
+            VkDeviceSize offset = 0;
+        };
+
+        const Entry &__find(const std::shared_ptr<Image> &image) const;
+
+        std::vector<Entry> m_entries;
+        VmaAllocation m_allocation = VK_NULL_HANDLE;
+        VkDeviceSize m_size = 0;
+    };
+}
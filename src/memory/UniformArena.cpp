@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "UniformArena.h"
+
+namespace mcvkp
+{
+    UniformArena::UniformArena(size_t numFrames, VkDeviceSize frameSize, VkBufferUsageFlags usage) : m_numFrames(numFrames)
+    {
+        if (numFrames == 0 || frameSize == 0)
+        {
+            throw std::invalid_argument("uniform arena needs at least one frame of at least one byte!");
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &properties);
+        // Indirect commands only need 4 bytes, which every uniform alignment is a multiple of.
+        m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 4);
+        // Regions start aligned, so offsets aligned within a region are aligned in the buffer.
+        m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+        if (m_frameSize * numFrames > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::invalid_argument("uniform arena is too large for 32 bit offsets!");
+        }
+
+        m_buffer = std::make_shared<Buffer>();
+        m_buffer->size = m_frameSize * numFrames;
+        BufferUtils::allocate(m_buffer.get(),
+                              m_buffer->size,
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | usage,
+                              VMA_MEMORY_USAGE_CPU_TO_GPU,
+                              VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    }
+
+    void UniformArena::beginFrame(size_t frame)
+    {
+        if (frame >= m_numFrames)
+        {
+            throw std::invalid_argument("uniform arena has no region for this frame!");
+        }
+        m_frameBegin = m_frameSize * frame;
+        m_head = m_frameBegin;
+    }
+
+    uint32_t UniformArena::allocate(const void *data, VkDeviceSize size)
+    {
+        if (m_head + size > m_frameBegin + m_frameSize)
+        {
+            throw std::runtime_error("failed to allocate uniform data, the frame's region is full!");
+        }
+        VkDeviceSize offset = m_head;
+        memcpy(static_cast<uint8_t *>(m_buffer->mappedData) + offset, data, size);
+        m_head = (offset + size + m_alignment - 1) / m_alignment * m_alignment;
+        return static_cast<uint32_t>(offset);
+    }
+
+    void UniformArena::flush()
+    {
+        // A no-op on host coherent memory, which CPU_TO_GPU usually is.
+        if (m_head > m_frameBegin)
+        {
+            vmaFlushAllocation(VulkanGlobal::context.allocator, m_buffer->allocation, m_frameBegin, m_head - m_frameBegin);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include "../utils/vulkan.h"
+#include "vk_mem_alloc.h"
+#include "Buffer.h"
+
+namespace mcvkp
+{
+    // Per-frame data written by the host, bump allocated from one persistently mapped buffer.
+    // The buffer holds a region for every frame in flight. A frame starts writing its region from the
+    // front again once its fence has signaled, so nothing is mapped, unmapped or allocated per frame.
+    // Allocations are read at the returned offset, as indirect commands or uniform data.
+    class UniformArena
+    {
+    public:
+        // Every frame gets frameSize bytes. usage is added to VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        // for indirect commands written by the host for example.
+        UniformArena(size_t numFrames, VkDeviceSize frameSize, VkBufferUsageFlags usage = 0);
+
+        // Starts the region of frame over. The last submission that read it must have finished.
+        void beginFrame(size_t frame);
+
+        // Copies size bytes into the current frame's region and returns their offset in the buffer.
+        // Offsets are aligned for uniform buffers, and so for indirect commands too.
+        uint32_t allocate(const void *data, VkDeviceSize size);
+
+        template <typename T>
+        uint32_t allocate(const T &value)
+        {
+            return allocate(&value, sizeof(T));
+        }
+
+        // Makes the current frame's writes visible to the device, call it before submitting the frame.
+        void flush();
+
+        VkBuffer getBuffer() const { return m_buffer->buffer; }
+
+    private:
+        std::shared_ptr<Buffer> m_buffer;
+        VkDeviceSize m_frameSize;
+        VkDeviceSize m_alignment;
+        size_t m_numFrames;
+
+        // Current frame's region is [m_frameBegin, m_frameBegin + m_frameSize), written up to m_head.
+        VkDeviceSize m_frameBegin = 0;
+        VkDeviceSize m_head = 0;
+    };
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "BatchRenderer.h"
+
+namespace mcvkp
+{
+    BatchRenderer::BatchRenderer(uint32_t width,
+                                 uint32_t height,
+                                 uint32_t batchSize,
+                                 size_t readbackSlots,
+                                 const std::string &computeShaderPath,
+                                 ReadbackRing::Consumer consumer) : m_width(width), m_height(height), m_batchSize(batchSize), m_consumer(consumer)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &properties);
+        if (batchSize == 0 || batchSize > properties.limits.maxImageArrayLayers)
+        {
+            throw std::invalid_argument("batch size must be between 1 and the device's maxImageArrayLayers!");
+        }
+
+        // Every descriptor set points at the same buffer, only the first one is bound.
+        auto viewParamsBuffer = std::make_shared<Buffer>();
+        viewParamsBuffer->size = sizeof(ViewParams);
+        BufferUtils::allocate(viewParamsBuffer.get(),
+                              sizeof(ViewParams) * batchSize,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VMA_MEMORY_USAGE_CPU_TO_GPU,
+                              VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        m_viewParams = std::make_shared<BufferBundle>(0);
+        m_viewParams->buffers.assign(VulkanGlobal::swapchainContext.swapChainImages.size(), viewParamsBuffer);
+
+        m_targetImage = std::make_shared<Image>();
+        ImageUtils::createImageArray(width,
+                                     height,
+                                     batchSize,
+                                     VK_FORMAT_R8G8B8A8_UNORM,
+                                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                     VK_IMAGE_ASPECT_COLOR_BIT,
+                                     VMA_MEMORY_USAGE_GPU_ONLY,
+                                     m_targetImage);
+
+        auto material = std::make_shared<ComputeMaterial>(computeShaderPath);
+        material->addStorageImage("img", m_targetImage, VK_SHADER_STAGE_COMPUTE_BIT);
+        material->addStorageBufferBundle("params", m_viewParams, VK_SHADER_STAGE_COMPUTE_BIT);
+        m_model = std::make_shared<ComputeModel>(material);
+
+        m_readbackRing = std::make_shared<ReadbackRing>(readbackSlots,
+                                                        width,
+                                                        height,
+                                                        4,
+                                                        [this](const ReadbackFrame &batch)
+                                                        { __deliverBatch(batch); },
+                                                        batchSize);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = VulkanGlobal::context.queueFamilyIndices.graphicsFamily.value();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(VulkanGlobal::context.device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create batch command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(VulkanGlobal::context.device, &allocInfo, &m_commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate batch command buffer!");
+        }
+    }
+
+    BatchRenderer::~BatchRenderer()
+    {
+        std::cout << "Destroying batch renderer"
+                  << "\n";
+        // The ring waits for its own copies, which are part of every batch submission.
+        m_readbackRing.reset();
+        vkDestroyCommandPool(VulkanGlobal::context.device, m_commandPool, nullptr);
+    }
+
+    void BatchRenderer::render(const std::vector<ViewParams> &views)
+    {
+        for (size_t first = 0; first < views.size(); first += m_batchSize)
+        {
+            uint32_t numViews = static_cast<uint32_t>(std::min<size_t>(m_batchSize, views.size() - first));
+            __submitBatch(views.data() + first, numViews, first);
+            m_readbackRing->poll();
+        }
+        m_readbackRing->flush();
+    }
+
+    void BatchRenderer::__submitBatch(const ViewParams *views, uint32_t numViews, uint64_t firstView)
+    {
+        // The parameter buffer and the command buffer are shared by all batches.
+        if (m_lastFence != VK_NULL_HANDLE)
+        {
+            vkWaitForFences(VulkanGlobal::context.device, 1, &m_lastFence, VK_TRUE, UINT64_MAX);
+        }
+
+        Buffer &viewParamsBuffer = *m_viewParams->buffers[0];
+        memcpy(viewParamsBuffer.mappedData, views, sizeof(ViewParams) * numViews);
+        vmaFlushAllocation(VulkanGlobal::context.allocator, viewParamsBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+        size_t slot = m_readbackRing->acquire(firstView);
+
+        vkResetCommandBuffer(m_commandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(m_commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording batch command buffer!");
+        }
+
+        // Previous contents are discarded, only the copy of the last batch has to be finished.
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_targetImage->image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, numViews};
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(m_commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+
+        // Edge workgroups are partially outside the image, the shader skips those invocations.
+        m_model->dispatch(m_commandBuffer, 0, {m_width, m_height, numViews});
+
+        m_readbackRing->recordCopy(m_commandBuffer,
+                                   slot,
+                                   *m_targetImage,
+                                   VK_IMAGE_LAYOUT_GENERAL,
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   VK_ACCESS_SHADER_WRITE_BIT,
+                                   numViews);
+
+        if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record batch command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_commandBuffer;
+
+        m_lastFence = m_readbackRing->getFence(slot);
+        if (vkQueueSubmit(VulkanGlobal::context.graphicsQueue, 1, &submitInfo, m_lastFence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit batch command buffer!");
+        }
+    }
+
+    void BatchRenderer::__deliverBatch(const ReadbackFrame &batch)
+    {
+        // Split the batch back into one frame per view.
+        for (uint32_t layer = 0; layer < batch.layers; layer++)
+        {
+            ReadbackFrame view = batch;
+            view.frameId = batch.frameId + layer;
+            view.layers = 1;
+            view.data = static_cast<const uint8_t *>(batch.data) + batch.layerPitch * layer;
+            m_consumer(view);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "../utils/glm.h"
+#include "../memory/Buffer.h"
+#include "../memory/Image.h"
+#include "../memory/ReadbackRing.h"
+#include "../scene/ComputeMaterial.h"
+#include "../scene/ComputeModel.h"
+
+namespace mcvkp
+{
+    // One view of a sweep, laid out like ViewParams in mandelbrot-batch.comp (std430).
+    struct ViewParams
+    {
+        glm::vec3 camPosition;
+        float time;
+    };
+
+    // Renders many views with one submission per batch.
+    // The views of a batch are uploaded to a storage buffer, rendered into the layers of an image
+    // array by a single dispatch along Z and read back by a single copy, so submission and fence
+    // overhead is paid once per batch instead of once per view.
+    class BatchRenderer
+    {
+    public:
+        // The consumer is called once per view, frameId being the index of the view.
+        BatchRenderer(uint32_t width,
+                      uint32_t height,
+                      uint32_t batchSize,
+                      size_t readbackSlots,
+                      const std::string &computeShaderPath,
+                      ReadbackRing::Consumer consumer);
+
+        ~BatchRenderer();
+
+        // Renders every view, blocking until all of them have been handed to the consumer.
+        void render(const std::vector<ViewParams> &views);
+
+    private:
+        void __submitBatch(const ViewParams *views, uint32_t numViews, uint64_t firstView);
+        void __deliverBatch(const ReadbackFrame &batch);
+
+    private:
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_batchSize;
+
+        std::shared_ptr<BufferBundle> m_viewParams;
+        std::shared_ptr<Image> m_targetImage;
+        std::shared_ptr<ComputeModel> m_model;
+        std::shared_ptr<ReadbackRing> m_readbackRing;
+        ReadbackRing::Consumer m_consumer;
+
+        VkCommandPool m_commandPool;
+        VkCommandBuffer m_commandBuffer;
+        // Fence of the last submitted batch, the view parameters can't be rewritten before it signals.
+        VkFence m_lastFence = VK_NULL_HANDLE;
+    };
+}
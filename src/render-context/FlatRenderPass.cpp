@@ -58,7 +58,8 @@ namespace mcvkp
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         // We don't care abot the initial layout because will draw on it
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // Present source for a real swapchain, transfer source for headless offscreen images.
+        colorAttachment.finalLayout = VulkanGlobal::swapchainContext.swapChainImageLayout;
 
         // Attachment for a sub-pass.
         VkAttachmentReference colorAttachmentRef{};
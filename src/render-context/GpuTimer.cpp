@@ -0,0 +1,87 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "GpuTimer.h"
+
+namespace mcvkp
+{
+    GpuTimer::GpuTimer(uint32_t numSlots, uint32_t queueFamilyIndex)
+    {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(VulkanGlobal::context.physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(VulkanGlobal::context.physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+        if (validBits == 0)
+        {
+            std::cout << "Timestamps are not supported on this queue, GPU time is not measured\n";
+            return;
+        }
+        m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &properties);
+        m_timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = numSlots * 2;
+        if (vkCreateQueryPool(VulkanGlobal::context.device, &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+
+    GpuTimer::~GpuTimer()
+    {
+        std::cout << "Destroying gpu timer"
+                  << "\n";
+        if (m_queryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(VulkanGlobal::context.device, m_queryPool, nullptr);
+        }
+    }
+
+    void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t slot)
+    {
+        if (!isSupported())
+        {
+            return;
+        }
+        vkCmdResetQueryPool(commandBuffer, m_queryPool, slot * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, slot * 2);
+    }
+
+    void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t slot)
+    {
+        if (!isSupported())
+        {
+            return;
+        }
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, slot * 2 + 1);
+    }
+
+    double GpuTimer::getMilliseconds(uint32_t slot)
+    {
+        if (!isSupported())
+        {
+            return 0;
+        }
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(VulkanGlobal::context.device,
+                                  m_queryPool,
+                                  slot * 2,
+                                  2,
+                                  sizeof(timestamps),
+                                  timestamps,
+                                  sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to read timestamp queries!");
+        }
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+        return ticks * m_timestampPeriod / 1e6;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../utils/vulkan.h"
+#include "../app-context/VulkanApplicationContext.h"
+
+namespace mcvkp
+{
+    // Measures GPU time between two points of a command buffer with timestamp queries.
+    // Every slot owns a begin and an end query, so one slot per command buffer in flight.
+    class GpuTimer
+    {
+    public:
+        GpuTimer(uint32_t numSlots, uint32_t queueFamilyIndex);
+
+        ~GpuTimer();
+
+        // False when the queue family can't write timestamps, all other calls are no-ops then.
+        bool isSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+        // Resets the slot's queries and writes the begin timestamp. Must be recorded outside a render pass.
+        void begin(VkCommandBuffer commandBuffer, uint32_t slot);
+
+        void end(VkCommandBuffer commandBuffer, uint32_t slot);
+
+        // Milliseconds between begin and end. Only valid once the submission using the slot has finished.
+        double getMilliseconds(uint32_t slot);
+
+    private:
+        VkQueryPool m_queryPool = VK_NULL_HANDLE;
+        // Nanoseconds per timestamp tick.
+        double m_timestampPeriod;
+        uint64_t m_timestampMask;
+    };
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <stdexcept>
+#include "LayoutCache.h"
+#include "../app-context/VulkanApplicationContext.h"
+
+namespace mcvkp
+{
+    LayoutCache::~LayoutCache()
+    {
+        destroy();
+    }
+
+    VkDescriptorSetLayout LayoutCache::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+    {
+        std::vector<uint64_t> key;
+        for (const VkDescriptorSetLayoutBinding &binding : bindings)
+        {
+            if (binding.pImmutableSamplers != nullptr)
+            {
+                throw std::invalid_argument("layouts with immutable samplers can't be cached!");
+            }
+            key.push_back(binding.binding);
+            key.push_back(binding.descriptorType);
+            key.push_back(binding.descriptorCount);
+            key.push_back(binding.stageFlags);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto cached = m_descriptorSetLayouts.find(key);
+        if (cached != m_descriptorSetLayouts.end())
+        {
+            return cached->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(VulkanGlobal::context.device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        m_descriptorSetLayouts[key] = layout;
+        return layout;
+    }
+
+    VkPipelineLayout LayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                                    const std::vector<VkPushConstantRange> &pushConstantRanges)
+    {
+        // Set layouts come from this cache, so equal handles mean equal layouts.
+        std::vector<uint64_t> key;
+        for (VkDescriptorSetLayout setLayout : setLayouts)
+        {
+            key.push_back((uint64_t)setLayout);
+        }
+        // Separates the sets from the ranges.
+        key.push_back(~0ull);
+        for (const VkPushConstantRange &range : pushConstantRanges)
+        {
+            key.push_back(range.stageFlags);
+            key.push_back(range.offset);
+            key.push_back(range.size);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto cached = m_pipelineLayouts.find(key);
+        if (cached != m_pipelineLayouts.end())
+        {
+            return cached->second;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+        VkPipelineLayout layout;
+        if (vkCreatePipelineLayout(VulkanGlobal::context.device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        m_pipelineLayouts[key] = layout;
+        return layout;
+    }
+
+    void LayoutCache::destroy()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_pipelineLayouts.empty() || !m_descriptorSetLayouts.empty())
+        {
+            std::cout << "Destroying " << m_pipelineLayouts.size() << " pipeline layouts and "
+                      << m_descriptorSetLayouts.size() << " descriptor set layouts\n";
+        }
+        for (auto &entry : m_pipelineLayouts)
+        {
+            vkDestroyPipelineLayout(VulkanGlobal::context.device, entry.second, nullptr);
+        }
+        m_pipelineLayouts.clear();
+        for (auto &entry : m_descriptorSetLayouts)
+        {
+            vkDestroyDescriptorSetLayout(VulkanGlobal::context.device, entry.second, nullptr);
+        }
+        m_descriptorSetLayouts.clear();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // Descriptor set and pipeline layouts shared by every material that asks for the same one.
+    // Layouts live until the cache is destroyed, materials never destroy them.
+    class LayoutCache
+    {
+    public:
+        // Destroys every layout, the device must still exist.
+        ~LayoutCache();
+
+        // Bindings must be sorted by binding number.
+        VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+        VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                           const std::vector<VkPushConstantRange> &pushConstantRanges);
+
+        // Also run by the destructor. Call it earlier when the device goes away first.
+        void destroy();
+
+    private:
+        std::mutex m_mutex;
+        std::map<std::vector<uint64_t>, VkDescriptorSetLayout> m_descriptorSetLayouts;
+        std::map<std::vector<uint64_t>, VkPipelineLayout> m_pipelineLayouts;
+    };
+}
+
+namespace VulkanGlobal {
+    extern mcvkp::LayoutCache layoutCache;
+}
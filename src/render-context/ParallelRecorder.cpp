@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <stdexcept>
+#include "ParallelRecorder.h"
+#include "../app-context/VulkanApplicationContext.h"
+
+namespace mcvkp
+{
+    ParallelRecorder::ParallelRecorder(size_t numFrames, uint32_t queueFamilyIndex, size_t threadCount) : m_numFrames(numFrames)
+    {
+        if (numFrames == 0)
+        {
+            throw std::invalid_argument("parallel recorder needs at least one frame!");
+        }
+        // hardware_concurrency is 0 when it can't be determined.
+        m_threads.resize(std::max<size_t>(threadCount, 1));
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+        // Buffers are rerecorded every frame and only reset with their pool.
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        for (ThreadState &thread : m_threads)
+        {
+            thread.frames.resize(numFrames);
+            for (FramePool &frame : thread.frames)
+            {
+                if (vkCreateCommandPool(VulkanGlobal::context.device, &poolInfo, nullptr, &frame.pool) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create recording thread command pool!");
+                }
+            }
+        }
+
+        // Thread 0 is the one calling record.
+        for (size_t thread = 1; thread < m_threads.size(); thread++)
+        {
+            m_threads[thread].thread = std::thread(&ParallelRecorder::__work, this, thread);
+        }
+    }
+
+    ParallelRecorder::~ParallelRecorder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_piecesAdded.notify_all();
+        for (ThreadState &thread : m_threads)
+        {
+            if (thread.thread.joinable())
+            {
+                thread.thread.join();
+            }
+            for (FramePool &frame : thread.frames)
+            {
+                vkDestroyCommandPool(VulkanGlobal::context.device, frame.pool, nullptr);
+            }
+        }
+    }
+
+    void ParallelRecorder::beginFrame(size_t frame)
+    {
+        if (frame >= m_numFrames)
+        {
+            throw std::invalid_argument("parallel recorder has no command pools for this frame!");
+        }
+
+        // Workers only touch their pools while record runs.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frame = frame;
+        for (ThreadState &thread : m_threads)
+        {
+            FramePool &framePool = thread.frames[frame];
+            vkResetCommandPool(VulkanGlobal::context.device, framePool.pool, 0);
+            framePool.used = 0;
+        }
+    }
+
+    void ParallelRecorder::record(VkCommandBuffer primary,
+                                  const std::vector<RecordFunction> &pieces,
+                                  const VkCommandBufferInheritanceInfo *inheritance)
+    {
+        if (pieces.empty())
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pieces = &pieces;
+        m_inheritance = inheritance ? *inheritance : VkCommandBufferInheritanceInfo{};
+        m_inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        m_recorded.assign(pieces.size(), VK_NULL_HANDLE);
+        m_nextPiece = 0;
+        m_finishedPieces = 0;
+        m_error = nullptr;
+        m_generation++;
+        m_piecesAdded.notify_all();
+
+        __recordPieces(lock, 0);
+        m_piecesDone.wait(lock, [this]
+                          { return m_finishedPieces == m_pieces->size(); });
+        m_pieces = nullptr;
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+
+        vkCmdExecuteCommands(primary, static_cast<uint32_t>(m_recorded.size()), m_recorded.data());
+    }
+
+    void ParallelRecorder::__work(size_t thread)
+    {
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_piecesAdded.wait(lock, [this, generation]
+                               { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+            __recordPieces(lock, thread);
+        }
+    }
+
+    void ParallelRecorder::__recordPieces(std::unique_lock<std::mutex> &lock, size_t thread)
+    {
+        // Pieces are taken one at a time, so threads that finish early take more of them.
+        while (m_pieces && m_nextPiece < m_pieces->size())
+        {
+            size_t piece = m_nextPiece++;
+            const RecordFunction &recordPiece = (*m_pieces)[piece];
+            VkCommandBufferInheritanceInfo inheritance = m_inheritance;
+            lock.unlock();
+
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            std::exception_ptr error;
+            try
+            {
+                commandBuffer = __getCommandBuffer(thread);
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                if (inheritance.renderPass != VK_NULL_HANDLE)
+                {
+                    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                }
+                beginInfo.pInheritanceInfo = &inheritance;
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to begin recording secondary command buffer!");
+                }
+
+                recordPiece(commandBuffer);
+
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to record secondary command buffer!");
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            m_recorded[piece] = commandBuffer;
+            if (error && !m_error)
+            {
+                m_error = error;
+            }
+            if (++m_finishedPieces == m_pieces->size())
+            {
+                m_piecesDone.notify_all();
+            }
+        }
+    }
+
+    VkCommandBuffer ParallelRecorder::__getCommandBuffer(size_t thread)
+    {
+        FramePool &framePool = m_threads[thread].frames[m_frame];
+        if (framePool.used == framePool.buffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = framePool.pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(VulkanGlobal::context.device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate secondary command buffer!");
+            }
+            framePool.buffers.push_back(commandBuffer);
+        }
+        return framePool.buffers[framePool.used++];
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // Records independent pieces of a command buffer on several threads.
+    // Every thread owns one command pool per frame in flight, so threads never share a pool and a
+    // frame's pools are reset as a whole once its fence has signaled. Each piece is recorded into a
+    // secondary command buffer, which the calling thread executes into its primary in order.
+    class ParallelRecorder
+    {
+    public:
+        using RecordFunction = std::function<void(VkCommandBuffer commandBuffer)>;
+
+        // The calling thread records too, so threadCount - 1 workers are started.
+        // Pools are created for queueFamilyIndex, the family of the primaries the pieces are executed into.
+        ParallelRecorder(size_t numFrames, uint32_t queueFamilyIndex, size_t threadCount = std::thread::hardware_concurrency());
+
+        // Waits for the workers to exit. The frames' submissions must have finished.
+        ~ParallelRecorder();
+
+        size_t getThreadCount() const { return m_threads.size(); }
+
+        // Resets the pools of frame. The last submission that executed their buffers must have finished.
+        void beginFrame(size_t frame);
+
+        // Records every piece into its own secondary command buffer and executes them into primary,
+        // in the order given. Pieces inside a render pass need inheritance with its render pass,
+        // subpass and framebuffer, and the pass has to be begun with
+        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Pieces set their own dynamic state.
+        // The first exception a piece throws is rethrown once all pieces are done.
+        void record(VkCommandBuffer primary,
+                    const std::vector<RecordFunction> &pieces,
+                    const VkCommandBufferInheritanceInfo *inheritance = nullptr);
+
+    private:
+        // Command buffers of one thread for one frame, reused once the pool is reset.
+        struct FramePool
+        {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> buffers;
+            size_t used = 0;
+        };
+
+        struct ThreadState
+        {
+            std::vector<FramePool> frames;
+            std::thread thread;
+        };
+
+        void __work(size_t thread);
+        void __recordPieces(std::unique_lock<std::mutex> &lock, size_t thread);
+        VkCommandBuffer __getCommandBuffer(size_t thread);
+
+        size_t m_numFrames;
+        size_t m_frame = 0;
+        std::vector<ThreadState> m_threads;
+
+        std::mutex m_mutex;
+        std::condition_variable m_piecesAdded;
+        std::condition_variable m_piecesDone;
+        bool m_stopping = false;
+        // Bumped for every record call, workers join each call once.
+        uint64_t m_generation = 0;
+
+        // The call being recorded.
+        const std::vector<RecordFunction> *m_pieces = nullptr;
+        VkCommandBufferInheritanceInfo m_inheritance{};
+        std::vector<VkCommandBuffer> m_recorded;
+        size_t m_nextPiece = 0;
+        size_t m_finishedPieces = 0;
+        std::exception_ptr m_error;
+    };
+}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include "RenderGraph.h"
+
+namespace mcvkp
+{
+    static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT |
+                                              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                              VK_ACCESS_TRANSFER_WRITE_BIT |
+                                              VK_ACCESS_HOST_WRITE_BIT |
+                                              VK_ACCESS_MEMORY_WRITE_BIT;
+
+    RenderGraph::Resource RenderGraph::importImage(VkImage image, const ResourceUse &lastUse)
+    {
+        ResourceState state{};
+        state.image = image;
+        return __import(state, lastUse);
+    }
+
+    RenderGraph::Resource RenderGraph::importBuffer(VkBuffer buffer, const ResourceUse &lastUse)
+    {
+        ResourceState state{};
+        state.buffer = buffer;
+        return __import(state, lastUse);
+    }
+
+    RenderGraph::Resource RenderGraph::__import(const ResourceState &state, const ResourceUse &lastUse)
+    {
+        m_resources.push_back(state);
+        ResourceState &imported = m_resources.back();
+        imported.layout = lastUse.layout;
+        if (lastUse.access & WRITE_ACCESS)
+        {
+            imported.writeStages = lastUse.stages;
+            imported.writeAccess = lastUse.access & WRITE_ACCESS;
+        }
+        else
+        {
+            imported.readStages = lastUse.stages;
+        }
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    void RenderGraph::markOutput(Resource resource)
+    {
+        m_resources.at(resource).output = true;
+    }
+
+    void RenderGraph::aliasMemory(Resource image, const std::vector<VkImage> &previousImages)
+    {
+        ResourceState &state = m_resources.at(image);
+        if (state.image == VK_NULL_HANDLE)
+        {
+            throw std::invalid_argument("only images can alias the memory of other images in a render graph!");
+        }
+        state.aliasedImages.insert(state.aliasedImages.end(), previousImages.begin(), previousImages.end());
+    }
+
+    void RenderGraph::exportResource(Resource resource, const ResourceUse &use)
+    {
+        markOutput(resource);
+        m_exports.push_back({resource, use});
+    }
+
+    void RenderGraph::addPass(const std::string &name, const std::vector<PassUse> &uses, RecordFunction record)
+    {
+        Pass pass{name, {}, record};
+        for (const PassUse &passUse : uses)
+        {
+            if (passUse.resource >= m_resources.size())
+            {
+                throw std::invalid_argument("render graph pass " + name + " uses a resource that wasn't imported!");
+            }
+            auto merged = std::find_if(pass.uses.begin(), pass.uses.end(), [&](const PassUse &other)
+                                       { return other.resource == passUse.resource; });
+            if (merged == pass.uses.end())
+            {
+                pass.uses.push_back(passUse);
+                continue;
+            }
+            const ResourceUse &use = passUse.use;
+            if (m_resources[passUse.resource].image != VK_NULL_HANDLE &&
+                merged->use.layout != VK_IMAGE_LAYOUT_UNDEFINED && use.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                merged->use.layout != use.layout)
+            {
+                throw std::invalid_argument("render graph pass " + name + " needs an image in two layouts at once!");
+            }
+            merged->use.stages |= use.stages;
+            merged->use.access |= use.access;
+            if (merged->use.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+            {
+                merged->use.layout = use.layout;
+            }
+        }
+        m_passes.push_back(std::move(pass));
+    }
+
+    void RenderGraph::execute(VkCommandBuffer commandBuffer)
+    {
+        size_t passCount = m_passes.size();
+
+        // The imported images each image shares memory with.
+        std::vector<std::vector<Resource> > aliases(m_resources.size());
+        for (size_t r = 0; r < m_resources.size(); r++)
+        {
+            for (VkImage aliasedImage : m_resources[r].aliasedImages)
+            {
+                for (size_t other = 0; other < m_resources.size(); other++)
+                {
+                    if (other != r && m_resources[other].image == aliasedImage)
+                    {
+                        aliases[r].push_back(static_cast<Resource>(other));
+                    }
+                }
+            }
+        }
+
+        // Dependencies in the order the passes were added. A layout change orders passes like a write,
+        // but only real writes make a pass the producer of what later passes read.
+        struct Tracking
+        {
+            std::optional<size_t> orderingWriter;
+            std::optional<size_t> dataWriter;
+            std::vector<size_t> readers;
+            VkImageLayout layout;
+            bool used = false;
+        };
+        std::vector<Tracking> tracking(m_resources.size());
+        for (size_t r = 0; r < m_resources.size(); r++)
+        {
+            tracking[r].layout = m_resources[r].layout;
+        }
+        // Every pass that has to run first, and the ones among them whose writes it needs.
+        std::vector<std::vector<size_t> > dependencies(passCount);
+        std::vector<std::vector<size_t> > producers(passCount);
+        std::vector<bool> alive(passCount, false);
+        for (size_t p = 0; p < passCount; p++)
+        {
+            for (const PassUse &use : m_passes[p].uses)
+            {
+                Tracking &t = tracking[use.resource];
+                bool transitions = m_resources[use.resource].image != VK_NULL_HANDLE &&
+                                   use.use.layout != VK_IMAGE_LAYOUT_UNDEFINED && use.use.layout != t.layout;
+                bool writes = (use.use.access & WRITE_ACCESS) != 0;
+                if (!t.used)
+                {
+                    // The first pass overwrites the memory of the images it aliases, after everything that used them.
+                    t.used = true;
+                    for (Resource alias : aliases[use.resource])
+                    {
+                        const Tracking &aliasTracking = tracking[alias];
+                        if (aliasTracking.orderingWriter)
+                        {
+                            dependencies[p].push_back(*aliasTracking.orderingWriter);
+                        }
+                        dependencies[p].insert(dependencies[p].end(), aliasTracking.readers.begin(), aliasTracking.readers.end());
+                    }
+                }
+                if (t.orderingWriter)
+                {
+                    dependencies[p].push_back(*t.orderingWriter);
+                }
+                if (t.dataWriter)
+                {
+                    producers[p].push_back(*t.dataWriter);
+                }
+                if (!writes && !transitions)
+                {
+                    t.readers.push_back(p);
+                    continue;
+                }
+                dependencies[p].insert(dependencies[p].end(), t.readers.begin(), t.readers.end());
+                t.readers.clear();
+                t.orderingWriter = p;
+                if (transitions)
+                {
+                    t.layout = use.use.layout;
+                }
+                if (writes)
+                {
+                    t.dataWriter = p;
+                    alive[p] = alive[p] || m_resources[use.resource].output;
+                }
+            }
+        }
+
+        // Culls passes nothing reads from. Producers come earlier, so one pass from the back finds them all.
+        for (size_t p = passCount; p-- > 0;)
+        {
+            if (alive[p])
+            {
+                for (size_t producer : producers[p])
+                {
+                    alive[producer] = true;
+                }
+            }
+        }
+
+        // A pass runs one level after the latest pass it depends on. Passes of a level are independent
+        // of each other, so a single barrier in front of the level covers all of them. Culled passes
+        // pass on the ordering of the passes they depend on.
+        std::vector<size_t> levels(passCount, 0);
+        std::vector<size_t> nextLevels(passCount, 0);
+        size_t levelCount = 0;
+        for (size_t p = 0; p < passCount; p++)
+        {
+            for (size_t dependency : dependencies[p])
+            {
+                levels[p] = std::max(levels[p], nextLevels[dependency]);
+            }
+            nextLevels[p] = alive[p] ? levels[p] + 1 : levels[p];
+            if (alive[p])
+            {
+                levelCount = std::max(levelCount, levels[p] + 1);
+            }
+        }
+
+        std::vector<bool> recorded(m_resources.size(), false);
+        for (size_t level = 0; level < levelCount; level++)
+        {
+            Barrier barrier;
+            for (size_t p = 0; p < passCount; p++)
+            {
+                if (alive[p] && levels[p] == level)
+                {
+                    for (const PassUse &use : m_passes[p].uses)
+                    {
+                        if (!recorded[use.resource])
+                        {
+                            recorded[use.resource] = true;
+                            for (Resource alias : aliases[use.resource])
+                            {
+                                const ResourceState &aliasState = m_resources[alias];
+                                barrier.srcStages |= aliasState.writeStages | aliasState.readStages;
+                                barrier.srcAccess |= aliasState.writeAccess;
+                                barrier.dstStages |= use.use.stages;
+                                barrier.dstAccess |= use.use.access;
+                            }
+                        }
+                        __addUse(barrier, m_resources[use.resource], use.use);
+                    }
+                }
+            }
+            __record(commandBuffer, barrier);
+            for (size_t p = 0; p < passCount; p++)
+            {
+                if (alive[p] && levels[p] == level)
+                {
+                    m_passes[p].record(commandBuffer);
+                }
+            }
+        }
+
+        Barrier exportBarrier;
+        for (const PassUse &use : m_exports)
+        {
+            __addUse(exportBarrier, m_resources[use.resource], use.use);
+        }
+        __record(commandBuffer, exportBarrier);
+    }
+
+    VkImageLayout RenderGraph::getLayout(Resource image) const
+    {
+        return m_resources.at(image).layout;
+    }
+
+    void RenderGraph::__addUse(Barrier &barrier, ResourceState &state, const ResourceUse &use) const
+    {
+        VkAccessFlags writeAccess = use.access & WRITE_ACCESS;
+        bool transitions = state.image != VK_NULL_HANDLE && use.layout != VK_IMAGE_LAYOUT_UNDEFINED && use.layout != state.layout;
+        if (transitions)
+        {
+            VkImageMemoryBarrier imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.oldLayout = state.layout;
+            imageBarrier.newLayout = use.layout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = state.image;
+            imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+            imageBarrier.srcAccessMask = state.writeAccess;
+            imageBarrier.dstAccessMask = use.access;
+            barrier.imageBarriers.push_back(imageBarrier);
+            barrier.srcStages |= state.writeStages | state.readStages;
+            barrier.dstStages |= use.stages;
+
+            // The transition is a write, visible to this use unless the use writes again.
+            state.layout = use.layout;
+            state.writeStages = use.stages;
+            state.writeAccess = writeAccess;
+            state.readStages = 0;
+            state.visibleStages = writeAccess ? 0 : use.stages;
+            state.visibleAccess = writeAccess ? 0 : use.access;
+            return;
+        }
+
+        if (writeAccess)
+        {
+            // Waits for the last write and for the reads after it, which only needs an execution dependency.
+            if (state.writeStages | state.readStages)
+            {
+                barrier.srcStages |= state.writeStages | state.readStages;
+                barrier.dstStages |= use.stages;
+                if (state.writeAccess)
+                {
+                    barrier.srcAccess |= state.writeAccess;
+                    barrier.dstAccess |= use.access;
+                }
+            }
+            state.writeStages = use.stages;
+            state.writeAccess = writeAccess;
+            state.readStages = 0;
+            state.visibleStages = 0;
+            state.visibleAccess = 0;
+            return;
+        }
+
+        // Reads only wait for a write that hasn't been made visible to them yet.
+        bool visible = (use.stages & ~state.visibleStages) == 0 && (use.access & ~state.visibleAccess) == 0;
+        if (state.writeStages && !visible)
+        {
+            barrier.srcStages |= state.writeStages;
+            barrier.dstStages |= use.stages;
+            barrier.srcAccess |= state.writeAccess;
+            barrier.dstAccess |= use.access;
+            state.visibleStages |= use.stages;
+            state.visibleAccess |= use.access;
+        }
+        state.readStages |= use.stages;
+    }
+
+    void RenderGraph::__record(VkCommandBuffer commandBuffer, const Barrier &barrier) const
+    {
+        if (barrier.dstStages == 0)
+        {
+            return;
+        }
+
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = barrier.srcAccess;
+        memoryBarrier.dstAccessMask = barrier.dstAccess;
+        uint32_t memoryBarrierCount = (barrier.srcAccess | barrier.dstAccess) ? 1 : 0;
+
+        // Nothing to wait for, only the transitions have to happen before the passes.
+        VkPipelineStageFlags srcStages = barrier.srcStages ? barrier.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            srcStages,
+            barrier.dstStages,
+            0,
+            memoryBarrierCount, &memoryBarrier,
+            0, nullptr,
+            static_cast<uint32_t>(barrier.imageBarriers.size()), barrier.imageBarriers.data());
+    }
+}
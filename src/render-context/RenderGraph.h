@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // How a pass touches a resource. Images also name the layout the pass needs, buffers ignore it.
+    // A use in VK_IMAGE_LAYOUT_UNDEFINED leaves the image's layout alone, an imported last use in it
+    // lets the first pass discard the contents.
+    struct ResourceUse
+    {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // The uses the passes of this repo need.
+    namespace ResourceUses
+    {
+        const ResourceUse storageRead{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        const ResourceUse storageWrite{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        const ResourceUse storageReadWrite{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                           VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                           VK_IMAGE_LAYOUT_GENERAL};
+        const ResourceUse sampledCompute{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        const ResourceUse sampledFragment{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        const ResourceUse indirectRead{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+        const ResourceUse transferWrite{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+        const ResourceUse transferRead{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        // Render passes transition their attachments themselves.
+        const ResourceUse colorAttachment{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+    }
+
+    // Records the passes of a frame with the barriers between them worked out from what each pass
+    // declares it reads and writes. Passes run in dependency order, passes that don't depend on each
+    // other share one batched barrier, and passes whose writes nothing reads are culled.
+    // A graph is built for one command buffer and one queue, and executed once.
+    class RenderGraph
+    {
+    public:
+        using Resource = uint32_t;
+        using RecordFunction = std::function<void(VkCommandBuffer commandBuffer)>;
+
+        struct PassUse
+        {
+            Resource resource;
+            ResourceUse use;
+        };
+
+        // lastUse is how the commands before the graph left the resource, stages 0 when there is
+        // nothing to wait for. Its stages must be supported by the queue the graph is recorded for.
+        // Images cover every mip level and array layer of the color aspect.
+        Resource importImage(VkImage image, const ResourceUse &lastUse);
+        Resource importBuffer(VkBuffer buffer, const ResourceUse &lastUse = {});
+
+        // The image reuses the memory of previousImages, which the graph is done with before the image's
+        // first pass. That pass waits for every pass that used them. Images that weren't imported are ignored.
+        void aliasMemory(Resource image, const std::vector<VkImage> &previousImages);
+
+        // Writes to an output outlive the graph, so the passes making them are never culled.
+        void markOutput(Resource resource);
+
+        // Brings the resource into use at the end of the graph, for commands recorded after it. Marks it as an output.
+        void exportResource(Resource resource, const ResourceUse &use);
+
+        // A resource may be listed more than once if the layouts agree, the uses are combined.
+        void addPass(const std::string &name, const std::vector<PassUse> &uses, RecordFunction record);
+
+        // Culls and orders the passes and records them with their barriers.
+        void execute(VkCommandBuffer commandBuffer);
+
+        // Layout the image is in after execute.
+        VkImageLayout getLayout(Resource image) const;
+
+    private:
+        struct ResourceState
+        {
+            VkImage image = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            bool output = false;
+            // Images whose memory this one reuses, see aliasMemory.
+            std::vector<VkImage> aliasedImages;
+
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            // The last write, or layout transition, and the reads after it.
+            VkPipelineStageFlags writeStages = 0;
+            VkAccessFlags writeAccess = 0;
+            VkPipelineStageFlags readStages = 0;
+            // Stages and accesses the last write has already been made visible to.
+            VkPipelineStageFlags visibleStages = 0;
+            VkAccessFlags visibleAccess = 0;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            std::vector<PassUse> uses;
+            RecordFunction record;
+        };
+
+        // One vkCmdPipelineBarrier, collected for all passes that run after it.
+        struct Barrier
+        {
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            VkAccessFlags srcAccess = 0;
+            VkAccessFlags dstAccess = 0;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+        };
+
+        Resource __import(const ResourceState &state, const ResourceUse &lastUse);
+        void __addUse(Barrier &barrier, ResourceState &state, const ResourceUse &use) const;
+        void __record(VkCommandBuffer commandBuffer, const Barrier &barrier) const;
+
+        std::vector<ResourceState> m_resources;
+        std::vector<Pass> m_passes;
+        std::vector<PassUse> m_exports;
+    };
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "ResolutionGovernor.h"
+
+namespace mcvkp
+{
+    // Weight of the newest frame time in the average.
+    static const float SMOOTHING = 0.2f;
+    // Frame times this close to the budget leave the scale alone, so it doesn't oscillate.
+    static const float DEADBAND = 0.05f;
+    // Largest relative change of the scale per frame.
+    static const float MAX_STEP = 0.05f;
+
+    ResolutionGovernor::ResolutionGovernor(float targetMilliseconds, float minScale, float maxScale) : m_targetMilliseconds(targetMilliseconds), m_minScale(minScale), m_maxScale(maxScale), m_scale(maxScale)
+    {
+        if (targetMilliseconds <= 0)
+        {
+            throw std::invalid_argument("frame time budget must be positive!");
+        }
+        if (minScale <= 0 || minScale > maxScale || maxScale > 1)
+        {
+            throw std::invalid_argument("render scale range must be inside (0, 1]!");
+        }
+    }
+
+    void ResolutionGovernor::addFrameTime(float milliseconds)
+    {
+        if (m_smoothedMilliseconds < 0)
+        {
+            m_smoothedMilliseconds = milliseconds;
+        }
+        else
+        {
+            m_smoothedMilliseconds += SMOOTHING * (milliseconds - m_smoothedMilliseconds);
+        }
+        if (m_smoothedMilliseconds <= 0)
+        {
+            return;
+        }
+
+        float ratio = m_targetMilliseconds / m_smoothedMilliseconds;
+        if (std::abs(ratio - 1.0f) < DEADBAND)
+        {
+            return;
+        }
+
+        // Ray marching cost follows the pixel count, which goes with the square of the scale.
+        float scale = m_scale * std::sqrt(ratio);
+        scale = std::clamp(scale, m_scale * (1.0f - MAX_STEP), m_scale * (1.0f + MAX_STEP));
+        m_scale = std::clamp(scale, m_minScale, m_maxScale);
+    }
+
+    VkExtent2D ResolutionGovernor::getExtent(VkExtent2D maxExtent) const
+    {
+        return {std::max(1u, static_cast<uint32_t>(maxExtent.width * m_scale + 0.5f)),
+                std::max(1u, static_cast<uint32_t>(maxExtent.height * m_scale + 0.5f))};
+    }
+}
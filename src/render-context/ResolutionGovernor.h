@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // Picks the scale the compute pass renders at from the GPU time of finished frames.
+    // The scale shrinks when frames go over the budget and grows back when there is room,
+    // at most a few percent per frame so a single slow frame doesn't make the image jump.
+    class ResolutionGovernor
+    {
+    public:
+        ResolutionGovernor(float targetMilliseconds, float minScale, float maxScale = 1.0f);
+
+        // Adjusts the scale of the next frames from the GPU time of a finished one.
+        void addFrameTime(float milliseconds);
+
+        float getScale() const { return m_scale; }
+
+        // Size of the region to render out of maxExtent at the current scale, at least one pixel.
+        VkExtent2D getExtent(VkExtent2D maxExtent) const;
+
+    private:
+        float m_targetMilliseconds;
+        float m_minScale;
+        float m_maxScale;
+        float m_scale;
+        // Exponential moving average of the frame times, negative before the first frame.
+        float m_smoothedMilliseconds = -1.0f;
+    };
+}
@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include "ShaderCompiler.h"
+#include "../utils/readfile.h"
+
+#ifdef MCVKP_WITH_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace mcvkp
+{
+    // Part of every hash, bump it when the compile options change so old cache entries are ignored.
+    static const char *const SHADER_CACHE_VERSION = "shaderc-vulkan1.0-O-1";
+
+    static void hashBytes(uint64_t &hash, const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 0x100000001b3ull;
+        }
+    }
+
+    static void hashString(uint64_t &hash, const std::string &value)
+    {
+        // The terminating zero keeps neighbouring strings from running into each other.
+        hashBytes(hash, value.c_str(), value.size() + 1);
+    }
+
+    static std::string readText(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("failed to open shader source " + path + "!");
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    // File named by an #include "..." line, resolved against the including file, or empty.
+    static std::string getIncludePath(const std::string &line, const std::filesystem::path &includingFile)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            return "";
+        }
+        size_t open = line.find('"', start + 8);
+        size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            return "";
+        }
+        return (includingFile.parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal().string();
+    }
+
+    // Hashes the file and, depth first, everything it includes. Each file counts once, like the include guards would.
+    static void hashSourceTree(uint64_t &hash, const std::string &path, std::set<std::string> &visited)
+    {
+        if (!visited.insert(path).second)
+        {
+            return;
+        }
+        std::string source = readText(path);
+        hashString(hash, source);
+
+        std::istringstream lines(source);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            std::string includePath = getIncludePath(line, path);
+            if (!includePath.empty())
+            {
+                hashSourceTree(hash, includePath, visited);
+            }
+        }
+    }
+
+    ShaderCompiler::ShaderCompiler(const std::string &cacheDirectory) : m_cacheDirectory(cacheDirectory)
+    {
+        std::filesystem::create_directories(m_cacheDirectory);
+        m_worker = std::thread(&ShaderCompiler::__work, this);
+    }
+
+    ShaderCompiler::~ShaderCompiler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAdded.notify_one();
+        m_worker.join();
+    }
+
+    bool ShaderCompiler::isAvailable()
+    {
+#ifdef MCVKP_WITH_SHADERC
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::shared_future<std::vector<char> > ShaderCompiler::compile(const std::string &sourcePath,
+                                                                   VkShaderStageFlagBits stage,
+                                                                   const ShaderDefines &defines)
+    {
+        uint64_t hash = __hashVariant(sourcePath, stage, defines);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto request = m_requests.find(hash);
+        if (request != m_requests.end())
+        {
+            return request->second;
+        }
+
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "%016llx.spv", static_cast<unsigned long long>(hash));
+        std::string cachePath = (std::filesystem::path(m_cacheDirectory) / fileName).string();
+
+        std::shared_future<std::vector<char> > code;
+        if (std::filesystem::exists(cachePath))
+        {
+            std::promise<std::vector<char> > cached;
+            cached.set_value(readFile(cachePath));
+            code = cached.get_future().share();
+        }
+        else
+        {
+            Job job{sourcePath, stage, defines, cachePath, {}};
+            code = job.result.get_future().share();
+            m_jobs.push_back(std::move(job));
+            m_jobAdded.notify_one();
+        }
+        m_requests[hash] = code;
+        return code;
+    }
+
+    uint64_t ShaderCompiler::__hashVariant(const std::string &sourcePath, VkShaderStageFlagBits stage, const ShaderDefines &defines) const
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hashString(hash, SHADER_CACHE_VERSION);
+        hashBytes(hash, reinterpret_cast<const char *>(&stage), sizeof(stage));
+        for (const auto &define : defines)
+        {
+            hashString(hash, define.first);
+            hashString(hash, define.second);
+        }
+        std::set<std::string> visited;
+        hashSourceTree(hash, std::filesystem::path(sourcePath).lexically_normal().string(), visited);
+        return hash;
+    }
+
+    void ShaderCompiler::__work()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobAdded.wait(lock, [this]
+                                { return m_stopping || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            try
+            {
+                std::vector<char> code = __compile(job);
+                __writeCache(job.cachePath, code);
+                job.result.set_value(std::move(code));
+            }
+            catch (...)
+            {
+                job.result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+#ifdef MCVKP_WITH_SHADERC
+    // Resolves #include "..." relative to the including file, as glslc does.
+    class FileIncluder : public shaderc::CompileOptions::IncluderInterface
+    {
+    public:
+        shaderc_include_result *GetInclude(const char *requestedSource,
+                                           shaderc_include_type type,
+                                           const char *requestingSource,
+                                           size_t includeDepth) override
+        {
+            auto *include = new Include();
+            include->path = (std::filesystem::path(requestingSource).parent_path() / requestedSource).lexically_normal().string();
+            try
+            {
+                include->content = readText(include->path);
+            }
+            catch (const std::exception &e)
+            {
+                // An empty name tells shaderc the include failed, the content is the message.
+                include->content = e.what();
+                include->path.clear();
+            }
+            include->result.source_name = include->path.c_str();
+            include->result.source_name_length = include->path.size();
+            include->result.content = include->content.c_str();
+            include->result.content_length = include->content.size();
+            include->result.user_data = include;
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result *data) override
+        {
+            delete static_cast<Include *>(data->user_data);
+        }
+
+    private:
+        struct Include
+        {
+            shaderc_include_result result;
+            std::string path;
+            std::string content;
+        };
+    };
+
+    static shaderc_shader_kind getShaderKind(VkShaderStageFlagBits stage)
+    {
+        switch (stage)
+        {
+        case VK_SHADER_STAGE_VERTEX_BIT:
+            return shaderc_glsl_vertex_shader;
+        case VK_SHADER_STAGE_FRAGMENT_BIT:
+            return shaderc_glsl_fragment_shader;
+        case VK_SHADER_STAGE_COMPUTE_BIT:
+            return shaderc_glsl_compute_shader;
+        default:
+            throw std::invalid_argument("shader stage can't be compiled at runtime!");
+        }
+    }
+
+    std::vector<char> ShaderCompiler::__compile(const Job &job) const
+    {
+        std::cout << "Compiling " << job.sourcePath << "\n";
+        shaderc::CompileOptions options;
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        options.SetIncluder(std::make_unique<FileIncluder>());
+        for (const auto &define : job.defines)
+        {
+            options.AddMacroDefinition(define.first, define.second);
+        }
+
+        shaderc::Compiler compiler;
+        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(readText(job.sourcePath),
+                                                                         getShaderKind(job.stage),
+                                                                         job.sourcePath.c_str(),
+                                                                         options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            throw std::runtime_error("failed to compile shader " + job.sourcePath + "!\n" + result.GetErrorMessage());
+        }
+        const char *begin = reinterpret_cast<const char *>(result.cbegin());
+        const char *end = reinterpret_cast<const char *>(result.cend());
+        return std::vector<char>(begin, end);
+    }
+#else
+    std::vector<char> ShaderCompiler::__compile(const Job &job) const
+    {
+        throw std::runtime_error("built without shaderc, can't compile shader " + job.sourcePath + "!");
+    }
+#endif
+
+    // Same temporary file and rename as the pipeline cache, so processes sharing the directory never read half a module.
+    void ShaderCompiler::__writeCache(const std::string &cachePath, const std::vector<char> &code) const
+    {
+        std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            file.write(code.data(), code.size());
+            if (!file)
+            {
+                throw std::runtime_error("failed to write shader cache entry!");
+            }
+        }
+        if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            throw std::runtime_error("failed to replace shader cache entry!");
+        }
+    }
+}
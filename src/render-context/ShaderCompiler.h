@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // Preprocessor definitions of a shader variant, name and value.
+    using ShaderDefines = std::vector<std::pair<std::string, std::string> >;
+
+    // Compiles GLSL to SPIR-V at runtime, so every variant of a shader doesn't have to be built ahead.
+    // Results are cached on disk under a hash of the source, every file it includes, the defines and
+    // the stage. Cache hits are read right away, misses are compiled on a background thread.
+    class ShaderCompiler
+    {
+    public:
+        // The directory is created when missing.
+        ShaderCompiler(const std::string &cacheDirectory);
+
+        // Finishes the compilations already queued.
+        ~ShaderCompiler();
+
+        // False when the build has no shaderc, then only variants already in the cache can be loaded.
+        static bool isAvailable();
+
+        // SPIR-V of the GLSL file at sourcePath. Compile errors are thrown by get().
+        // Requests for the same variant share one compilation.
+        std::shared_future<std::vector<char> > compile(const std::string &sourcePath,
+                                                       VkShaderStageFlagBits stage,
+                                                       const ShaderDefines &defines = {});
+
+    private:
+        struct Job
+        {
+            std::string sourcePath;
+            VkShaderStageFlagBits stage;
+            ShaderDefines defines;
+            std::string cachePath;
+            std::promise<std::vector<char> > result;
+        };
+
+        uint64_t __hashVariant(const std::string &sourcePath, VkShaderStageFlagBits stage, const ShaderDefines &defines) const;
+        std::vector<char> __compile(const Job &job) const;
+        void __writeCache(const std::string &cachePath, const std::vector<char> &code) const;
+        void __work();
+
+        std::string m_cacheDirectory;
+
+        std::mutex m_mutex;
+        std::condition_variable m_jobAdded;
+        std::deque<Job> m_jobs;
+        bool m_stopping = false;
+        // Every variant requested so far, by hash.
+        std::map<uint64_t, std::shared_future<std::vector<char> > > m_requests;
+
+        std::thread m_worker;
+    };
+}
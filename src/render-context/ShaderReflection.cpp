@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include "ShaderReflection.h"
+
+namespace mcvkp
+{
+    // The parts of the SPIR-V specification reflection needs, numbered as in spirv.h.
+    static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+    static const uint32_t OP_NAME = 5;
+    static const uint32_t OP_ENTRY_POINT = 15;
+    static const uint32_t OP_EXECUTION_MODE = 16;
+    static const uint32_t OP_TYPE_BOOL = 20;
+    static const uint32_t OP_TYPE_INT = 21;
+    static const uint32_t OP_TYPE_FLOAT = 22;
+    static const uint32_t OP_TYPE_VECTOR = 23;
+    static const uint32_t OP_TYPE_MATRIX = 24;
+    static const uint32_t OP_TYPE_IMAGE = 25;
+    static const uint32_t OP_TYPE_SAMPLER = 26;
+    static const uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+    static const uint32_t OP_TYPE_ARRAY = 28;
+    static const uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+    static const uint32_t OP_TYPE_STRUCT = 30;
+    static const uint32_t OP_TYPE_POINTER = 32;
+    static const uint32_t OP_CONSTANT = 43;
+    static const uint32_t OP_CONSTANT_COMPOSITE = 44;
+    static const uint32_t OP_SPEC_CONSTANT = 50;
+    static const uint32_t OP_SPEC_CONSTANT_COMPOSITE = 51;
+    static const uint32_t OP_VARIABLE = 59;
+    static const uint32_t OP_DECORATE = 71;
+    static const uint32_t OP_MEMBER_DECORATE = 72;
+    static const uint32_t OP_EXECUTION_MODE_ID = 331;
+
+    static const uint32_t DECORATION_SPEC_ID = 1;
+    static const uint32_t DECORATION_BUFFER_BLOCK = 3;
+    static const uint32_t DECORATION_ARRAY_STRIDE = 6;
+    static const uint32_t DECORATION_MATRIX_STRIDE = 7;
+    static const uint32_t DECORATION_BUILT_IN = 11;
+    static const uint32_t DECORATION_BINDING = 33;
+    static const uint32_t DECORATION_DESCRIPTOR_SET = 34;
+    static const uint32_t DECORATION_OFFSET = 35;
+
+    static const uint32_t BUILT_IN_WORKGROUP_SIZE = 25;
+
+    static const uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+    static const uint32_t EXECUTION_MODE_LOCAL_SIZE_ID = 38;
+
+    static const uint32_t STORAGE_CLASS_UNIFORM_CONSTANT = 0;
+    static const uint32_t STORAGE_CLASS_UNIFORM = 2;
+    static const uint32_t STORAGE_CLASS_PUSH_CONSTANT = 9;
+    static const uint32_t STORAGE_CLASS_STORAGE_BUFFER = 12;
+
+    static const uint32_t DIM_BUFFER = 5;
+    static const uint32_t DIM_SUBPASS_DATA = 6;
+
+    // Everything known about one result id.
+    struct SpirvId
+    {
+        uint32_t opcode = 0;
+        // Type of constants and variables, a pointer type for the latter.
+        uint32_t resultType = 0;
+        // Words after the result id.
+        std::vector<uint32_t> operands;
+
+        // From OpName, glslang names every variable and type it declares.
+        std::string name;
+        std::optional<uint32_t> set;
+        std::optional<uint32_t> binding;
+        std::optional<uint32_t> specId;
+        std::optional<uint32_t> arrayStride;
+        bool bufferBlock = false;
+        bool workgroupSize = false;
+        std::map<uint32_t, uint32_t> memberOffsets;
+        std::map<uint32_t, uint32_t> memberMatrixStrides;
+    };
+
+    struct SpirvModule
+    {
+        std::map<uint32_t, SpirvId> ids;
+        uint32_t executionModel = ~0u;
+        std::optional<VkExtent3D> localSize;
+        std::vector<uint32_t> localSizeIds;
+
+        const SpirvId &get(uint32_t id) const
+        {
+            auto found = ids.find(id);
+            if (found == ids.end())
+            {
+                throw std::runtime_error("failed to reflect shader, id " + std::to_string(id) + " is never defined!");
+            }
+            return found->second;
+        }
+    };
+
+    static SpirvModule parseModule(const std::vector<char> &code)
+    {
+        const uint32_t *words = reinterpret_cast<const uint32_t *>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+        if (code.size() % sizeof(uint32_t) != 0 || wordCount < 5 || words[0] != SPIRV_MAGIC)
+        {
+            throw std::runtime_error("failed to reflect shader, the code is not SPIR-V!");
+        }
+
+        SpirvModule module;
+        // Instructions start after the five word header.
+        for (size_t i = 5; i < wordCount;)
+        {
+            uint32_t length = words[i] >> 16;
+            uint32_t opcode = words[i] & 0xffff;
+            if (length == 0 || i + length > wordCount)
+            {
+                throw std::runtime_error("failed to reflect shader, truncated instruction!");
+            }
+            const uint32_t *instruction = words + i;
+            i += length;
+
+            switch (opcode)
+            {
+            case OP_NAME:
+                if (length >= 3)
+                {
+                    // A nul terminated string packed into the remaining words, the first character in the low byte.
+                    const char *name = reinterpret_cast<const char *>(instruction + 2);
+                    module.ids[instruction[1]].name.assign(name, strnlen(name, (length - 2) * sizeof(uint32_t)));
+                }
+                break;
+            case OP_ENTRY_POINT:
+                // glslang emits one entry point, main.
+                module.executionModel = instruction[1];
+                break;
+            case OP_EXECUTION_MODE:
+                if (instruction[2] == EXECUTION_MODE_LOCAL_SIZE && length >= 6)
+                {
+                    module.localSize = VkExtent3D{instruction[3], instruction[4], instruction[5]};
+                }
+                break;
+            case OP_EXECUTION_MODE_ID:
+                if (instruction[2] == EXECUTION_MODE_LOCAL_SIZE_ID && length >= 6)
+                {
+                    module.localSizeIds.assign(instruction + 3, instruction + 6);
+                }
+                break;
+            case OP_DECORATE:
+            {
+                if (length < 3)
+                {
+                    break;
+                }
+                SpirvId &target = module.ids[instruction[1]];
+                uint32_t literal = length > 3 ? instruction[3] : 0;
+                switch (instruction[2])
+                {
+                case DECORATION_SPEC_ID:
+                    target.specId = literal;
+                    break;
+                case DECORATION_BUFFER_BLOCK:
+                    target.bufferBlock = true;
+                    break;
+                case DECORATION_ARRAY_STRIDE:
+                    target.arrayStride = literal;
+                    break;
+                case DECORATION_BUILT_IN:
+                    target.workgroupSize = literal == BUILT_IN_WORKGROUP_SIZE;
+                    break;
+                case DECORATION_BINDING:
+                    target.binding = literal;
+                    break;
+                case DECORATION_DESCRIPTOR_SET:
+                    target.set = literal;
+                    break;
+                }
+                break;
+            }
+            case OP_MEMBER_DECORATE:
+            {
+                if (length < 5)
+                {
+                    break;
+                }
+                SpirvId &target = module.ids[instruction[1]];
+                if (instruction[3] == DECORATION_OFFSET)
+                {
+                    target.memberOffsets[instruction[2]] = instruction[4];
+                }
+                else if (instruction[3] == DECORATION_MATRIX_STRIDE)
+                {
+                    target.memberMatrixStrides[instruction[2]] = instruction[4];
+                }
+                break;
+            }
+            case OP_TYPE_BOOL:
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+            case OP_TYPE_VECTOR:
+            case OP_TYPE_MATRIX:
+            case OP_TYPE_IMAGE:
+            case OP_TYPE_SAMPLER:
+            case OP_TYPE_SAMPLED_IMAGE:
+            case OP_TYPE_ARRAY:
+            case OP_TYPE_RUNTIME_ARRAY:
+            case OP_TYPE_STRUCT:
+            case OP_TYPE_POINTER:
+            {
+                SpirvId &type = module.ids[instruction[1]];
+                type.opcode = opcode;
+                type.operands.assign(instruction + 2, instruction + length);
+                break;
+            }
+            case OP_CONSTANT:
+            case OP_CONSTANT_COMPOSITE:
+            case OP_SPEC_CONSTANT:
+            case OP_SPEC_CONSTANT_COMPOSITE:
+            case OP_VARIABLE:
+            {
+                // These have a result type in front of the result id.
+                if (length < 3)
+                {
+                    break;
+                }
+                SpirvId &value = module.ids[instruction[2]];
+                value.opcode = opcode;
+                value.resultType = instruction[1];
+                value.operands.assign(instruction + 3, instruction + length);
+                break;
+            }
+            }
+        }
+        return module;
+    }
+
+    static uint32_t getConstantValue(const SpirvModule &module, uint32_t id)
+    {
+        const SpirvId &constant = module.get(id);
+        if ((constant.opcode != OP_CONSTANT && constant.opcode != OP_SPEC_CONSTANT) || constant.operands.empty())
+        {
+            throw std::runtime_error("failed to reflect shader, expected a scalar constant!");
+        }
+        // Specialization constants reflect their default.
+        return constant.operands[0];
+    }
+
+    // Bytes the type takes in a push constant block. Matrix stride is a member decoration, so the caller passes it.
+    static uint32_t getTypeSize(const SpirvModule &module, uint32_t typeId, uint32_t matrixStride = 0)
+    {
+        const SpirvId &type = module.get(typeId);
+        switch (type.opcode)
+        {
+        case OP_TYPE_BOOL:
+            return 4;
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+            return type.operands[0] / 8;
+        case OP_TYPE_VECTOR:
+            return type.operands[1] * getTypeSize(module, type.operands[0]);
+        case OP_TYPE_MATRIX:
+            return type.operands[1] * (matrixStride != 0 ? matrixStride : getTypeSize(module, type.operands[0]));
+        case OP_TYPE_ARRAY:
+        {
+            uint32_t length = getConstantValue(module, type.operands[1]);
+            return length * type.arrayStride.value_or(getTypeSize(module, type.operands[0]));
+        }
+        case OP_TYPE_RUNTIME_ARRAY:
+            return 0;
+        case OP_TYPE_STRUCT:
+        {
+            uint32_t size = 0;
+            for (uint32_t member = 0; member < type.operands.size(); member++)
+            {
+                auto offset = type.memberOffsets.find(member);
+                auto stride = type.memberMatrixStrides.find(member);
+                uint32_t memberSize = getTypeSize(module, type.operands[member], stride != type.memberMatrixStrides.end() ? stride->second : 0);
+                size = std::max(size, (offset != type.memberOffsets.end() ? offset->second : 0) + memberSize);
+            }
+            return size;
+        }
+        default:
+            throw std::runtime_error("failed to reflect shader, unsupported type in a push constant block!");
+        }
+    }
+
+    static VkShaderStageFlags getStageFlags(uint32_t executionModel)
+    {
+        switch (executionModel)
+        {
+        case 0:
+            return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1:
+            return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2:
+            return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3:
+            return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4:
+            return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5:
+            return VK_SHADER_STAGE_COMPUTE_BIT;
+        default:
+            throw std::runtime_error("failed to reflect shader, unsupported execution model!");
+        }
+    }
+
+    static VkDescriptorType getImageDescriptorType(const SpirvId &image)
+    {
+        uint32_t dim = image.operands[1];
+        // 1 is sampled, 2 is read or written without a sampler.
+        bool storage = image.operands[5] == 2;
+        if (dim == DIM_BUFFER)
+        {
+            return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        if (dim == DIM_SUBPASS_DATA)
+        {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+
+    static ReflectedBinding reflectBinding(const SpirvModule &module, const SpirvId &variable, uint32_t storageClass, uint32_t typeId)
+    {
+        ReflectedBinding binding{};
+        binding.set = variable.set.value_or(0);
+        binding.binding = variable.binding.value();
+        binding.descriptorCount = 1;
+        binding.name = variable.name;
+
+        const SpirvId *type = &module.get(typeId);
+        while (type->opcode == OP_TYPE_ARRAY || type->opcode == OP_TYPE_RUNTIME_ARRAY)
+        {
+            if (type->opcode == OP_TYPE_RUNTIME_ARRAY)
+            {
+                throw std::runtime_error("failed to reflect shader, unsized descriptor arrays are not supported!");
+            }
+            binding.descriptorCount *= getConstantValue(module, type->operands[1]);
+            type = &module.get(type->operands[0]);
+        }
+        // A block declared without an instance name leaves its variable unnamed.
+        if (binding.name.empty())
+        {
+            binding.name = type->name;
+        }
+
+        if (storageClass == STORAGE_CLASS_STORAGE_BUFFER)
+        {
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+        else if (storageClass == STORAGE_CLASS_UNIFORM)
+        {
+            // SPIR-V 1.0 declares storage buffers as Uniform blocks decorated BufferBlock.
+            binding.descriptorType = type->bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        else if (type->opcode == OP_TYPE_SAMPLED_IMAGE)
+        {
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        else if (type->opcode == OP_TYPE_SAMPLER)
+        {
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        }
+        else if (type->opcode == OP_TYPE_IMAGE)
+        {
+            binding.descriptorType = getImageDescriptorType(*type);
+        }
+        else
+        {
+            throw std::runtime_error("failed to reflect shader, unsupported descriptor type!");
+        }
+        return binding;
+    }
+
+    static bool isBindingBefore(const ReflectedBinding &a, const ReflectedBinding &b)
+    {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    }
+
+    bool ReflectedBinding::operator==(const ReflectedBinding &other) const
+    {
+        return set == other.set && binding == other.binding && descriptorType == other.descriptorType &&
+               descriptorCount == other.descriptorCount && stageFlags == other.stageFlags && name == other.name;
+    }
+
+    uint32_t ShaderReflection::getSetCount() const
+    {
+        uint32_t count = 0;
+        for (const ReflectedBinding &binding : bindings)
+        {
+            count = std::max(count, binding.set + 1);
+        }
+        return count;
+    }
+
+    bool ShaderReflection::hasSameLayout(const ShaderReflection &other) const
+    {
+        return stageFlags == other.stageFlags && bindings == other.bindings &&
+               pushConstantSize == other.pushConstantSize && pushConstantStageFlags == other.pushConstantStageFlags;
+    }
+
+    ShaderReflection reflectShader(const std::vector<char> &code)
+    {
+        SpirvModule module = parseModule(code);
+
+        ShaderReflection reflection;
+        reflection.stageFlags = getStageFlags(module.executionModel);
+
+        for (const auto &entry : module.ids)
+        {
+            const SpirvId &variable = entry.second;
+            if (variable.opcode != OP_VARIABLE || variable.operands.empty())
+            {
+                continue;
+            }
+            uint32_t storageClass = variable.operands[0];
+            if (storageClass != STORAGE_CLASS_UNIFORM_CONSTANT && storageClass != STORAGE_CLASS_UNIFORM &&
+                storageClass != STORAGE_CLASS_STORAGE_BUFFER && storageClass != STORAGE_CLASS_PUSH_CONSTANT)
+            {
+                continue;
+            }
+            // OpTypePointer's operands are the storage class and the pointee.
+            uint32_t typeId = module.get(variable.resultType).operands.at(1);
+            if (storageClass == STORAGE_CLASS_PUSH_CONSTANT)
+            {
+                reflection.pushConstantSize = std::max(reflection.pushConstantSize, getTypeSize(module, typeId));
+                reflection.pushConstantStageFlags = reflection.stageFlags;
+                continue;
+            }
+            if (!variable.binding.has_value())
+            {
+                throw std::runtime_error("failed to reflect shader, a descriptor has no binding!");
+            }
+            ReflectedBinding binding = reflectBinding(module, variable, storageClass, typeId);
+            binding.stageFlags = reflection.stageFlags;
+            reflection.bindings.push_back(binding);
+        }
+        std::sort(reflection.bindings.begin(), reflection.bindings.end(), isBindingBefore);
+
+        if (reflection.stageFlags == VK_SHADER_STAGE_COMPUTE_BIT)
+        {
+            if (module.localSize.has_value())
+            {
+                reflection.workgroupSize = module.localSize.value();
+            }
+            // local_size_x_id makes glslang emit a WorkgroupSize built-in, which replaces LocalSize, or LocalSizeId in newer SPIR-V.
+            std::vector<uint32_t> sizeIds = module.localSizeIds;
+            for (const auto &entry : module.ids)
+            {
+                if (entry.second.workgroupSize && entry.second.operands.size() == 3)
+                {
+                    sizeIds = entry.second.operands;
+                }
+            }
+            if (!sizeIds.empty())
+            {
+                reflection.workgroupSize = {getConstantValue(module, sizeIds[0]),
+                                            getConstantValue(module, sizeIds[1]),
+                                            getConstantValue(module, sizeIds[2])};
+                for (size_t axis = 0; axis < 3; axis++)
+                {
+                    reflection.workgroupSizeIds[axis] = module.get(sizeIds[axis]).specId;
+                }
+            }
+        }
+        return reflection;
+    }
+
+    ShaderReflection mergeReflections(const std::vector<ShaderReflection> &stages)
+    {
+        ShaderReflection merged;
+        for (const ShaderReflection &stage : stages)
+        {
+            merged.stageFlags |= stage.stageFlags;
+            if (stage.pushConstantSize > 0)
+            {
+                merged.pushConstantSize = std::max(merged.pushConstantSize, stage.pushConstantSize);
+                merged.pushConstantStageFlags |= stage.pushConstantStageFlags;
+            }
+            for (const ReflectedBinding &binding : stage.bindings)
+            {
+                auto existing = std::find_if(merged.bindings.begin(), merged.bindings.end(), [&binding](const ReflectedBinding &other)
+                                             { return other.set == binding.set && other.binding == binding.binding; });
+                if (existing == merged.bindings.end())
+                {
+                    merged.bindings.push_back(binding);
+                }
+                else if (existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount ||
+                         existing->name != binding.name)
+                {
+                    throw std::runtime_error("failed to merge shader stages, they declare binding " + std::to_string(binding.binding) + " differently!");
+                }
+                else
+                {
+                    existing->stageFlags |= binding.stageFlags;
+                }
+            }
+        }
+        std::sort(merged.bindings.begin(), merged.bindings.end(), isBindingBefore);
+        return merged;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+
+namespace mcvkp
+{
+    // A descriptor a shader declares, with layout(set = ..., binding = ...).
+    struct ReflectedBinding
+    {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType descriptorType;
+        // Elements of a descriptor array, 1 otherwise.
+        uint32_t descriptorCount;
+        VkShaderStageFlags stageFlags;
+        // Name of the variable, or of its block when the block has no instance name.
+        // Empty when the SPIR-V was stripped of debug names.
+        std::string name;
+
+        bool operator==(const ReflectedBinding &other) const;
+    };
+
+    // Interface of one or more shader stages, read from their SPIR-V.
+    struct ShaderReflection
+    {
+        VkShaderStageFlags stageFlags = 0;
+        // Sorted by set, then binding.
+        std::vector<ReflectedBinding> bindings;
+        // Size of the push constant block, 0 without one. Stages that declare it are pushConstantStageFlags.
+        uint32_t pushConstantSize = 0;
+        VkShaderStageFlags pushConstantStageFlags = 0;
+
+        // Compute only: local_size, and the specialization constant ids that override it when the
+        // shader declares local_size_x_id and friends.
+        VkExtent3D workgroupSize = {1, 1, 1};
+        std::optional<uint32_t> workgroupSizeIds[3];
+
+        // Number of descriptor sets a pipeline layout needs, sets the shader skips included.
+        uint32_t getSetCount() const;
+
+        // Whether a pipeline built for one can bind the resources of the other.
+        bool hasSameLayout(const ShaderReflection &other) const;
+    };
+
+    // Reads the entry point's stage, descriptors, push constants and workgroup size.
+    // Throws on malformed SPIR-V and on unsized descriptor arrays.
+    ShaderReflection reflectShader(const std::vector<char> &code);
+
+    // Interface of a pipeline built from several stages. Descriptors both declare are visible to both.
+    ShaderReflection mergeReflections(const std::vector<ShaderReflection> &stages);
+}
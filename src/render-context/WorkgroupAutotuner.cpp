@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include "WorkgroupAutotuner.h"
+#include "GpuTimer.h"
+#include "RenderSystem.h"
+
+namespace mcvkp
+{
+    // Shapes worth trying, square ones as well as wide rows that suit some memory layouts.
+    static const std::vector<VkExtent2D> WORKGROUP_CANDIDATES = {
+        {8, 8}, {16, 8}, {8, 16}, {16, 16}, {32, 4}, {32, 8}, {8, 32}, {32, 16}, {32, 32}, {64, 1}, {64, 2}, {64, 4}, {128, 1}, {256, 1}};
+
+    // Timed submissions per candidate, the median is kept.
+    static const int TIMED_RUNS = 5;
+
+    WorkgroupAutotuner::WorkgroupAutotuner(const std::string &cachePath) : m_cachePath(cachePath)
+    {
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &m_properties);
+
+        std::ifstream file(cachePath);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            Entry entry{};
+            if (fields >> entry.vendorID >> entry.deviceID >> entry.driverVersion >> entry.kernelName >> entry.workgroupSize.width >> entry.workgroupSize.height)
+            {
+                m_entries.push_back(entry);
+            }
+        }
+    }
+
+    std::optional<VkExtent2D> WorkgroupAutotuner::getCached(const std::string &kernelName) const
+    {
+        for (const Entry &entry : m_entries)
+        {
+            if (entry.vendorID == m_properties.vendorID &&
+                entry.deviceID == m_properties.deviceID &&
+                entry.driverVersion == m_properties.driverVersion &&
+                entry.kernelName == kernelName)
+            {
+                return entry.workgroupSize;
+            }
+        }
+        return std::nullopt;
+    }
+
+    VkExtent2D WorkgroupAutotuner::clampToDevice(VkExtent2D workgroupSize)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanGlobal::context.physicalDevice, &properties);
+        const VkPhysicalDeviceLimits &limits = properties.limits;
+
+        while (workgroupSize.width > limits.maxComputeWorkGroupSize[0] ||
+               workgroupSize.height > limits.maxComputeWorkGroupSize[1] ||
+               workgroupSize.width * workgroupSize.height > limits.maxComputeWorkGroupInvocations)
+        {
+            if (workgroupSize.width >= workgroupSize.height)
+            {
+                workgroupSize.width = std::max(workgroupSize.width / 2, 1u);
+            }
+            else
+            {
+                workgroupSize.height = std::max(workgroupSize.height / 2, 1u);
+            }
+        }
+        return workgroupSize;
+    }
+
+    VkExtent2D WorkgroupAutotuner::tune(const std::string &kernelName,
+                                        VkExtent2D extent,
+                                        const ModelFactory &factory,
+                                        VkImageLayout outputLayout)
+    {
+        const VkPhysicalDeviceLimits &limits = m_properties.limits;
+
+        VkExtent2D best = clampToDevice({32, 32});
+        double bestTime = -1;
+        for (VkExtent2D candidate : WORKGROUP_CANDIDATES)
+        {
+            if (candidate.width > limits.maxComputeWorkGroupSize[0] ||
+                candidate.height > limits.maxComputeWorkGroupSize[1] ||
+                candidate.width * candidate.height > limits.maxComputeWorkGroupInvocations)
+            {
+                continue;
+            }
+
+            std::shared_ptr<ComputeModel> model = factory(candidate);
+            double time = __time(*model, extent, outputLayout);
+            std::cout << "Workgroup " << candidate.width << "x" << candidate.height << ": " << time << " ms\n";
+            if (time < 0)
+            {
+                // No timestamps on this queue, nothing to compare.
+                return best;
+            }
+            if (bestTime < 0 || time < bestTime)
+            {
+                bestTime = time;
+                best = candidate;
+            }
+        }
+
+        std::cout << "Fastest workgroup for " << kernelName << ": " << best.width << "x" << best.height << "\n";
+        __store(kernelName, best);
+        return best;
+    }
+
+    // Median GPU time of one dispatch over extent, or -1 without timestamp support.
+    double WorkgroupAutotuner::__time(ComputeModel &model, VkExtent2D extent, VkImageLayout outputLayout)
+    {
+        GpuTimer timer(1, VulkanGlobal::context.queueFamilyIndices.graphicsFamily.value());
+        if (!timer.isSupported())
+        {
+            return -1;
+        }
+
+        // Only the output is transitioned, any other storage image is expected to stay in GENERAL.
+        const std::shared_ptr<Image> &output = model.getMaterial()->getStorageImages()[0].data->images[0];
+        VkImageMemoryBarrier toGeneral{};
+        toGeneral.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toGeneral.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        toGeneral.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toGeneral.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.image = output->image;
+        toGeneral.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, output->layers};
+        toGeneral.srcAccessMask = 0;
+        toGeneral.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+        VkImageMemoryBarrier toOutputLayout = toGeneral;
+        toOutputLayout.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toOutputLayout.newLayout = outputLayout;
+        toOutputLayout.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        toOutputLayout.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        // The first run only warms up caches and clocks.
+        std::vector<double> times;
+        for (int run = 0; run <= TIMED_RUNS; run++)
+        {
+            VkCommandBuffer commandBuffer = RenderSystem::beginSingleTimeCommands();
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 1, &toGeneral);
+            timer.begin(commandBuffer, 0);
+            model.dispatch(commandBuffer, 0, {extent.width, extent.height, 1});
+            timer.end(commandBuffer, 0);
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 1, &toOutputLayout);
+            RenderSystem::endSingleTimeCommands(commandBuffer);
+
+            if (run > 0)
+            {
+                times.push_back(timer.getMilliseconds(0));
+            }
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    void WorkgroupAutotuner::__store(const std::string &kernelName, VkExtent2D workgroupSize)
+    {
+        Entry entry{m_properties.vendorID, m_properties.deviceID, m_properties.driverVersion, kernelName, workgroupSize};
+        auto existing = std::find_if(m_entries.begin(), m_entries.end(), [&entry](const Entry &other)
+                                     { return other.vendorID == entry.vendorID &&
+                                              other.deviceID == entry.deviceID &&
+                                              other.driverVersion == entry.driverVersion &&
+                                              other.kernelName == entry.kernelName; });
+        if (existing != m_entries.end())
+        {
+            *existing = entry;
+        }
+        else
+        {
+            m_entries.push_back(entry);
+        }
+        __save();
+    }
+
+    // Same temporary file and rename as the pipeline cache, so workers sharing the file never read half of it.
+    void WorkgroupAutotuner::__save() const
+    {
+        std::string tmpPath = m_cachePath + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::trunc);
+            for (const Entry &entry : m_entries)
+            {
+                file << entry.vendorID << " " << entry.deviceID << " " << entry.driverVersion << " "
+                     << entry.kernelName << " " << entry.workgroupSize.width << " " << entry.workgroupSize.height << "\n";
+            }
+            if (!file)
+            {
+                throw std::runtime_error("failed to write workgroup cache!");
+            }
+        }
+        if (std::rename(tmpPath.c_str(), m_cachePath.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            throw std::runtime_error("failed to replace workgroup cache!");
+        }
+    }
+}
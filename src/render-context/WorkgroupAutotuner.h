@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "../utils/vulkan.h"
+#include "../scene/ComputeModel.h"
+
+namespace mcvkp
+{
+    // Picks the fastest workgroup shape of a compute kernel on the current device.
+    // Every candidate the device supports is built through the factory and timed with timestamp
+    // queries. The winner is cached in a text file keyed by vendor, device, driver version and
+    // kernel name, because the best shape differs a lot between GPUs.
+    class WorkgroupAutotuner
+    {
+    public:
+        // Builds the kernel with the given workgroup size, bound to the resources of the real frame.
+        using ModelFactory = std::function<std::shared_ptr<ComputeModel>(VkExtent2D workgroupSize)>;
+
+        WorkgroupAutotuner(const std::string &cachePath);
+
+        std::optional<VkExtent2D> getCached(const std::string &kernelName) const;
+
+        // Times every supported candidate dispatching over extent, caches and returns the fastest.
+        // Descriptor set 0 is used. Its first storage image is the output and is left in
+        // outputLayout, the others have to be in GENERAL already.
+        VkExtent2D tune(const std::string &kernelName,
+                        VkExtent2D extent,
+                        const ModelFactory &factory,
+                        VkImageLayout outputLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        // Fits a workgroup size into the device limits by halving its larger side.
+        static VkExtent2D clampToDevice(VkExtent2D workgroupSize);
+
+    private:
+        struct Entry
+        {
+            uint32_t vendorID;
+            uint32_t deviceID;
+            uint32_t driverVersion;
+            std::string kernelName;
+            VkExtent2D workgroupSize;
+        };
+
+        double __time(ComputeModel &model, VkExtent2D extent, VkImageLayout outputLayout);
+        void __store(const std::string &kernelName, VkExtent2D workgroupSize);
+        void __save() const;
+
+    private:
+        std::string m_cachePath;
+        std::vector<Entry> m_entries;
+        VkPhysicalDeviceProperties m_properties;
+    };
+}
@@ -1,5 +1,7 @@
 #include <vector>
 #include <memory>
+#include <iostream>
+#include <chrono>
 #include "../utils/readfile.h"
 
 #include "ComputeMaterial.h"
@@ -11,34 +13,156 @@ namespace mcvkp
         m_descriptorSetsSize = VulkanGlobal::swapchainContext.swapChainImages.size();
     }
 
+    ComputeMaterial::ComputeMaterial(const std::shared_future<std::vector<char> > &computeShaderCode) : m_computeShaderCode(computeShaderCode)
+    {
+        m_descriptorSetsSize = VulkanGlobal::swapchainContext.swapChainImages.size();
+    }
+
+    ComputeMaterial::~ComputeMaterial()
+    {
+        for (auto &pendingPipeline : m_pendingPipelines)
+        {
+            try
+            {
+                m_retiredPipelines.push_back(pendingPipeline.get());
+            }
+            catch (const std::exception &)
+            {
+                // Failed reloads have nothing to destroy.
+            }
+        }
+        destroyRetiredPipelines();
+    }
+
     void ComputeMaterial::init()
     {
-        __initDescriptorSetLayout();
-        __initComputePipeline(m_computeShaderPath);
+        std::vector<char> shaderCode = m_computeShaderCode.valid() ? m_computeShaderCode.get() : readFile(m_computeShaderPath);
+        m_reflection = reflectShader(shaderCode);
+        if (m_reflection.stageFlags != VK_SHADER_STAGE_COMPUTE_BIT)
+        {
+            throw std::invalid_argument("compute materials need a compute shader!");
+        }
+        if (!m_workgroupSize.has_value())
+        {
+            m_workgroupSize = VkExtent2D{m_reflection.workgroupSize.width, m_reflection.workgroupSize.height};
+        }
+        __checkWorkgroupSize(m_reflection);
+
+        __initDescriptorSetLayouts();
+        __initPipelineLayout();
+        m_pipeline = __createPipeline(shaderCode);
         __initDescriptorPool();
         __initDescriptorSets();
     }
 
-    void ComputeMaterial::__initComputePipeline(const std::string &computeShaderPath)
+    VkExtent2D ComputeMaterial::getWorkgroupSize() const
     {
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+        if (!m_workgroupSize.has_value())
+        {
+            throw std::runtime_error("workgroup size is unknown before the shader is reflected!");
+        }
+        return m_workgroupSize.value();
+    }
+
+    void ComputeMaterial::reload(const std::shared_future<std::vector<char> > &computeShaderCode)
+    {
+        m_pendingPipelines.push_back(std::async(std::launch::async, [this, computeShaderCode]()
+                                                { return __createReloadedPipeline(computeShaderCode.get()); }));
+    }
+
+    VkPipeline ComputeMaterial::__createReloadedPipeline(const std::vector<char> &shaderCode)
+    {
+        // The descriptor sets and pipeline layout stay, so the new shader has to fit them.
+        ShaderReflection reflection = reflectShader(shaderCode);
+        if (!reflection.hasSameLayout(m_reflection))
+        {
+            throw std::runtime_error("reloaded shader changed its bindings or push constants!");
+        }
+        __checkWorkgroupSize(reflection);
+        return __createPipeline(shaderCode);
+    }
 
-        if (vkCreatePipelineLayout(VulkanGlobal::context.device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+    bool ComputeMaterial::swapPipeline()
+    {
+        bool swapped = false;
+        // Reloads finish in order, so the newest finished one ends up bound.
+        while (!m_pendingPipelines.empty() &&
+               m_pendingPipelines.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
         {
-            throw std::runtime_error("failed to create pipeline layout!");
+            try
+            {
+                VkPipeline pipeline = m_pendingPipelines.front().get();
+                m_retiredPipelines.push_back(m_pipeline);
+                m_pipeline = pipeline;
+                swapped = true;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Keeping the previous compute pipeline: " << e.what() << "\n";
+            }
+            m_pendingPipelines.pop_front();
         }
+        return swapped;
+    }
 
-        std::vector<char> shaderCode = readFile(computeShaderPath);
+    void ComputeMaterial::destroyRetiredPipelines()
+    {
+        for (VkPipeline pipeline : m_retiredPipelines)
+        {
+            vkDestroyPipeline(VulkanGlobal::context.device, pipeline, nullptr);
+        }
+        m_retiredPipelines.clear();
+    }
+
+    void ComputeMaterial::__checkWorkgroupSize(const ShaderReflection &reflection) const
+    {
+        if (reflection.workgroupSize.depth != 1)
+        {
+            throw std::invalid_argument("compute shaders must have a local_size_z of 1!");
+        }
+        VkExtent2D workgroupSize = m_workgroupSize.value();
+        bool overridable = reflection.workgroupSizeIds[0].has_value() && reflection.workgroupSizeIds[1].has_value();
+        if (!overridable && (workgroupSize.width != reflection.workgroupSize.width || workgroupSize.height != reflection.workgroupSize.height))
+        {
+            throw std::invalid_argument("the shader's workgroup size can't be changed without local_size_x_id and local_size_y_id!");
+        }
+    }
+
+    // Only reads state fixed at init, so reloads can build pipelines on other threads.
+    VkPipeline ComputeMaterial::__createPipeline(const std::vector<char> &shaderCode)
+    {
         VkShaderModule shaderModule = __createShaderModule(shaderCode);
 
+        // The workgroup size goes in front of the user constants, under the ids the shader reflected.
+        std::vector<VkSpecializationMapEntry> specializationEntries;
+        std::vector<uint8_t> specializationData(2 * sizeof(uint32_t));
+        VkExtent2D workgroupSize = m_workgroupSize.value();
+        memcpy(specializationData.data(), &workgroupSize.width, sizeof(uint32_t));
+        memcpy(specializationData.data() + sizeof(uint32_t), &workgroupSize.height, sizeof(uint32_t));
+        if (m_reflection.workgroupSizeIds[0].has_value() && m_reflection.workgroupSizeIds[1].has_value())
+        {
+            specializationEntries.push_back({m_reflection.workgroupSizeIds[0].value(), 0, sizeof(uint32_t)});
+            specializationEntries.push_back({m_reflection.workgroupSizeIds[1].value(), sizeof(uint32_t), sizeof(uint32_t)});
+        }
+        for (VkSpecializationMapEntry entry : m_specializationEntries)
+        {
+            entry.offset += static_cast<uint32_t>(2 * sizeof(uint32_t));
+            specializationEntries.push_back(entry);
+        }
+        specializationData.insert(specializationData.end(), m_specializationData.begin(), m_specializationData.end());
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = specializationData.size();
+        specializationInfo.pData = specializationData.data();
+
         VkPipelineShaderStageCreateInfo shaderStageInfo{};
         shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         shaderStageInfo.module = shaderModule;
         shaderStageInfo.pName = "main";
+        shaderStageInfo.pSpecializationInfo = &specializationInfo;
 
         VkComputePipelineCreateInfo computePipelineCreateInfo{};
         computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -46,18 +170,36 @@ namespace mcvkp
         computePipelineCreateInfo.flags = 0;
         computePipelineCreateInfo.stage = shaderStageInfo;
 
-        if (vkCreateComputePipelines(VulkanGlobal::context.device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS)
+        VkPipeline pipeline;
+        VkResult result = vkCreateComputePipelines(VulkanGlobal::context.device, VulkanGlobal::context.pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(VulkanGlobal::context.device, shaderModule, nullptr);
+        if (result != VK_SUCCESS)
         {
-            throw std::runtime_error("failed to create graphics pipeline!");
+            throw std::runtime_error("failed to create compute pipeline!");
         }
-
-        vkDestroyShaderModule(VulkanGlobal::context.device, shaderModule, nullptr);
+        return pipeline;
     }
 
     void ComputeMaterial::bind(VkCommandBuffer &commandBuffer, size_t currentFrame)
     {
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[currentFrame], 0, nullptr);
+        if (!m_descriptorSetLayouts.empty())
+        {
+            uint32_t setCount = static_cast<uint32_t>(m_descriptorSetLayouts.size());
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, setCount, &m_descriptorSets[currentFrame * setCount], 0, nullptr);
+        }
 
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+        __pushConstantBlock(commandBuffer);
+    }
+
+    void ComputeMaterial::pushDispatchBounds(VkCommandBuffer &commandBuffer, VkExtent3D extent)
+    {
+        if (m_reflection.pushConstantSize < sizeof(DispatchBounds))
+        {
+            return;
+        }
+        DispatchBounds bounds{extent.width, extent.height, extent.depth, 0};
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(bounds), &bounds);
     }
 }
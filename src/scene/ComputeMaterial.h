@@ -1,6 +1,10 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <optional>
 #include "../memory/Buffer.h"
 #include "../utils/vulkan.h"
 #include "../memory/Image.h"
@@ -9,19 +13,80 @@
 
 namespace mcvkp
 {
+    // Push constant every compute pipeline starts with, DispatchBounds in dispatch.glsl.
+    struct DispatchBounds
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t padding;
+    };
+
     class ComputeMaterial : public Material
     {
     public:
         ComputeMaterial(const std::string &computeShaderPath);
 
+        // SPIR-V that may still be compiling, see ShaderCompiler. init waits for it.
+        ComputeMaterial(const std::shared_future<std::vector<char> > &computeShaderCode);
+
+        ~ComputeMaterial();
+
         void init();
 
+        // Builds a pipeline from new SPIR-V on a background thread, the current one stays in use until
+        // swapPipeline. Shaders that change their bindings or push constants are rejected.
+        void reload(const std::shared_future<std::vector<char> > &computeShaderCode);
+
+        // Switches to the newest reloaded pipeline that is built, without waiting for any. The pipeline
+        // it replaces is retired, command buffers recorded before still use it. Returns whether it switched.
+        bool swapPipeline();
+
+        // Destroys the retired pipelines, once no command buffer that uses them is in flight.
+        void destroyRetiredPipelines();
+
         void bind(VkCommandBuffer &commandBuffer, size_t currentFrame);
 
+        // Pushes the region the next dispatch covers, the shader skips invocations outside of it.
+        // Nothing is pushed to shaders that don't declare DispatchBounds.
+        void pushDispatchBounds(VkCommandBuffer &commandBuffer, VkExtent3D extent);
+
+        // Must be set before init, defaults to the shader's local_size. Sizes other than that need
+        // local_size_x_id and local_size_y_id in the shader.
+        void setWorkgroupSize(VkExtent2D workgroupSize) { m_workgroupSize = workgroupSize; }
+
+        // Known once set or once init has reflected the shader.
+        VkExtent2D getWorkgroupSize() const;
+
+        // Sets a 32 bit specialization constant (int, uint, float or VkBool32). Must be called before init.
+        template <typename T>
+        void addSpecializationConstant(uint32_t constantId, const T &value)
+        {
+            static_assert(sizeof(T) == 4, "specialization constants are 32 bit");
+            VkSpecializationMapEntry entry{};
+            entry.constantID = constantId;
+            entry.offset = static_cast<uint32_t>(m_specializationData.size());
+            entry.size = sizeof(T);
+            m_specializationEntries.push_back(entry);
+            m_specializationData.resize(entry.offset + sizeof(T));
+            memcpy(m_specializationData.data() + entry.offset, &value, sizeof(T));
+        }
+
     private:
-        void __initComputePipeline(const std::string &computeShaderPath);
+        // Throws when the shader can't run with m_workgroupSize.
+        void __checkWorkgroupSize(const ShaderReflection &reflection) const;
+        VkPipeline __createPipeline(const std::vector<char> &shaderCode);
+        VkPipeline __createReloadedPipeline(const std::vector<char> &shaderCode);
 
     private:
         std::string m_computeShaderPath;
+        std::shared_future<std::vector<char> > m_computeShaderCode;
+
+        std::optional<VkExtent2D> m_workgroupSize;
+        std::vector<VkSpecializationMapEntry> m_specializationEntries;
+        std::vector<uint8_t> m_specializationData;
+
+        std::deque<std::future<VkPipeline> > m_pendingPipelines;
+        std::vector<VkPipeline> m_retiredPipelines;
     };
 }
@@ -18,9 +18,27 @@ namespace mcvkp
         return m_material;
     }
 
-    void ComputeModel::computeCommand(VkCommandBuffer &commandBuffer, size_t currentFrame, size_t x, size_t y, size_t z)
+    void ComputeModel::dispatch(VkCommandBuffer &commandBuffer, size_t currentFrame, VkExtent3D extent)
     {
+        VkExtent3D groupCount = getGroupCount(extent);
         m_material->bind(commandBuffer, currentFrame);
-        vkCmdDispatch(commandBuffer, x, y, z);
+        m_material->pushDispatchBounds(commandBuffer, extent);
+        vkCmdDispatch(commandBuffer, groupCount.width, groupCount.height, groupCount.depth);
+    }
+
+    void ComputeModel::dispatchIndirect(VkCommandBuffer &commandBuffer, size_t currentFrame, VkExtent3D bounds, VkBuffer buffer, VkDeviceSize offset)
+    {
+        m_material->bind(commandBuffer, currentFrame);
+        m_material->pushDispatchBounds(commandBuffer, bounds);
+        vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+    }
+
+    VkExtent3D ComputeModel::getGroupCount(VkExtent3D extent) const
+    {
+        // Workgroups are always one invocation deep.
+        VkExtent2D workgroupSize = m_material->getWorkgroupSize();
+        return {(extent.width + workgroupSize.width - 1) / workgroupSize.width,
+                (extent.height + workgroupSize.height - 1) / workgroupSize.height,
+                extent.depth};
     }
 }
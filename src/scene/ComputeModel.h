@@ -15,7 +15,18 @@ namespace mcvkp
         ComputeModel(std::shared_ptr<ComputeMaterial> material);
 
         std::shared_ptr<ComputeMaterial> getMaterial();
-        void computeCommand(VkCommandBuffer &commandBuffer, size_t currentFrame, size_t x, size_t y, size_t z);
+
+        // Covers extent with as many workgroups as needed, rounding up at the edges.
+        void dispatch(VkCommandBuffer &commandBuffer, size_t currentFrame, VkExtent3D extent);
+
+        // Reads the group counts from a VkDispatchIndirectCommand the GPU wrote into buffer at offset.
+        // The buffer needs VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT and its writes must be made visible to
+        // VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT with VK_ACCESS_INDIRECT_COMMAND_READ_BIT. Invocations
+        // outside bounds are still skipped, whatever group counts were written.
+        void dispatchIndirect(VkCommandBuffer &commandBuffer, size_t currentFrame, VkExtent3D bounds, VkBuffer buffer, VkDeviceSize offset = 0);
+
+        // Number of workgroups dispatch uses for extent.
+        VkExtent3D getGroupCount(VkExtent3D extent) const;
 
     private:
         std::shared_ptr<ComputeMaterial> m_material;
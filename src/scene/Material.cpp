@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <vector>
 #include <memory>
+#include <string>
 #include "../utils/readfile.h"
 
 #include "Material.h"
@@ -22,9 +24,8 @@ namespace mcvkp
     {
         std::cout << "Destroying material"
                   << "\n";
-        vkDestroyDescriptorSetLayout(VulkanGlobal::context.device, m_descriptorSetLayout, nullptr);
+        // Layouts belong to VulkanGlobal::layoutCache.
         vkDestroyPipeline(VulkanGlobal::context.device, m_pipeline, nullptr);
-        vkDestroyPipelineLayout(VulkanGlobal::context.device, m_pipelineLayout, nullptr);
         vkDestroyDescriptorPool(VulkanGlobal::context.device, m_descriptorPool, nullptr);
     }
 
@@ -43,19 +44,44 @@ namespace mcvkp
         return shaderModule;
     }
 
-    void Material::addTexture(const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags)
+    void Material::addTexture(const std::string &name, const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags)
     {
-        m_textureDescriptors.push_back({texture, shaderStageFlags});
+        auto textureBundle = std::make_shared<TextureBundle>();
+        textureBundle->textures.assign(m_descriptorSetsSize, texture);
+        addTextureBundle(name, textureBundle, shaderStageFlags);
     }
 
-    void Material::addBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags)
+    void Material::addTextureBundle(const std::string &name, const std::shared_ptr<TextureBundle> &textureBundle, VkShaderStageFlags shaderStageFlags)
     {
-        m_bufferBundleDescriptors.push_back({bufferBundle, shaderStageFlags});
+        m_textureDescriptors.push_back({textureBundle, shaderStageFlags, name});
     }
 
-    void Material::addStorageImage(const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags)
+    void Material::addBufferBundle(const std::string &name, const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags)
     {
-        m_storageImageDescriptors.push_back({image, shaderStageFlags});
+        m_bufferBundleDescriptors.push_back({bufferBundle, shaderStageFlags, name});
+    }
+
+    void Material::addStorageImage(const std::string &name, const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags)
+    {
+        auto imageBundle = std::make_shared<ImageBundle>(0);
+        imageBundle->images.assign(m_descriptorSetsSize, image);
+        addStorageImageBundle(name, imageBundle, shaderStageFlags);
+    }
+
+    void Material::addStorageImageBundle(const std::string &name, const std::shared_ptr<ImageBundle> &imageBundle, VkShaderStageFlags shaderStageFlags)
+    {
+        m_storageImageDescriptors.push_back({imageBundle, shaderStageFlags, name});
+    }
+
+    void Material::addStorageBufferBundle(const std::string &name, const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags)
+    {
+        m_storageBufferBundleDescriptors.push_back({bufferBundle, shaderStageFlags, name});
+    }
+
+    void Material::setPushConstants(const std::shared_ptr<PushConstantBlock> &pushConstants, uint32_t offset)
+    {
+        m_pushConstants = pushConstants;
+        m_pushConstantOffset = offset;
     }
 
     const std::vector<Descriptor<BufferBundle> > &Material::getBufferBundles() const
@@ -63,16 +89,21 @@ namespace mcvkp
         return m_bufferBundleDescriptors;
     }
 
-    const std::vector<Descriptor<Texture> > &Material::getTextures() const
+    const std::vector<Descriptor<TextureBundle> > &Material::getTextures() const
     {
         return m_textureDescriptors;
     }
 
-    const std::vector<Descriptor<Image> > &Material::getStorageImages() const
+    const std::vector<Descriptor<ImageBundle> > &Material::getStorageImages() const
     {
         return m_storageImageDescriptors;
     }
 
+    const std::vector<Descriptor<BufferBundle> > &Material::getStorageBufferBundles() const
+    {
+        return m_storageBufferBundleDescriptors;
+    }
+
     // Initialize material when adding to a scene.
     void Material::init(const VkRenderPass &renderPass)
     {
@@ -80,8 +111,13 @@ namespace mcvkp
         {
             return;
         }
-        __initDescriptorSetLayout();
-        __initPipeline(VulkanGlobal::swapchainContext.swapChainExtent, renderPass, m_vertexShaderPath, m_fragmentShaderPath);
+        auto vertShaderCode = readFile(m_vertexShaderPath);
+        auto fragShaderCode = readFile(m_fragmentShaderPath);
+        m_reflection = mergeReflections({reflectShader(vertShaderCode), reflectShader(fragShaderCode)});
+
+        __initDescriptorSetLayouts();
+        __initPipelineLayout();
+        __initPipeline(VulkanGlobal::swapchainContext.swapChainExtent, renderPass, vertShaderCode, fragShaderCode);
         __initDescriptorPool();
         __initDescriptorSets();
         m_initialized = true;
@@ -89,11 +125,9 @@ namespace mcvkp
 
     void Material::__initPipeline(const VkExtent2D &swapChainExtent,
                                   const VkRenderPass &renderPass,
-                                  std::string vertexShaderPath,
-                                  std::string fragmentShaderPath)
+                                  const std::vector<char> &vertShaderCode,
+                                  const std::vector<char> &fragShaderCode)
     {
-        auto vertShaderCode = readFile(vertexShaderPath);
-        auto fragShaderCode = readFile(fragmentShaderPath);
         VkShaderModule vertShaderModule = __createShaderModule(vertShaderCode);
         VkShaderModule fragShaderModule = __createShaderModule(fragShaderCode);
 
@@ -196,16 +230,6 @@ namespace mcvkp
         dynamicState.dynamicStateCount = 2;
         dynamicState.pDynamicStates = dynamicStates;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-
-        if (vkCreatePipelineLayout(VulkanGlobal::context.device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
         VkPipelineDepthStencilStateCreateInfo depthStencil{};
         depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         depthStencil.depthTestEnable = VK_TRUE;
@@ -237,7 +261,7 @@ namespace mcvkp
         pipelineInfo.basePipelineIndex = -1;              // Optional
         pipelineInfo.pDepthStencilState = &depthStencil;
 
-        if (vkCreateGraphicsPipelines(VulkanGlobal::context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS)
+        if (vkCreateGraphicsPipelines(VulkanGlobal::context.device, VulkanGlobal::context.pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
@@ -246,85 +270,112 @@ namespace mcvkp
         vkDestroyShaderModule(VulkanGlobal::context.device, vertShaderModule, nullptr);
     }
 
-    void Material::__initDescriptorSetLayout()
+    // Gives each of the material's resources of one kind the shader's binding of the same name.
+    // matched marks the reflected bindings that got a resource.
+    template <typename T>
+    static void assignBindings(const ShaderReflection &reflection,
+                               std::vector<Descriptor<T> > &descriptors,
+                               VkDescriptorType descriptorType,
+                               std::vector<bool> &matched)
     {
-        std::vector<VkDescriptorSetLayoutBinding> bindings;
-
-        for (size_t buffer_i = 0; buffer_i < m_bufferBundleDescriptors.size(); buffer_i++)
+        for (Descriptor<T> &descriptor : descriptors)
         {
-            VkDescriptorSetLayoutBinding uboLayoutBinding{};
-            uboLayoutBinding.binding = buffer_i;
-            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            uboLayoutBinding.descriptorCount = 1;
-            uboLayoutBinding.stageFlags = m_bufferBundleDescriptors[buffer_i].shaderStageFlags;
-            uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-            bindings.push_back(uboLayoutBinding);
+            auto binding = std::find_if(reflection.bindings.begin(), reflection.bindings.end(), [&descriptor](const ReflectedBinding &other)
+                                        { return other.name == descriptor.name; });
+            if (binding == reflection.bindings.end())
+            {
+                throw std::runtime_error("failed to match material resource " + descriptor.name + ", the shader declares no descriptor of that name!");
+            }
+            if (binding->descriptorType != descriptorType)
+            {
+                throw std::runtime_error("failed to match material resource " + descriptor.name + ", the shader declares it as another descriptor type!");
+            }
+            size_t index = binding - reflection.bindings.begin();
+            if (matched[index])
+            {
+                throw std::runtime_error("failed to match material resource " + descriptor.name + ", the material has it twice!");
+            }
+            matched[index] = true;
+            descriptor.set = binding->set;
+            descriptor.binding = binding->binding;
         }
+    }
 
-        for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
+    void Material::__initDescriptorSetLayouts()
+    {
+        for (const ReflectedBinding &binding : m_reflection.bindings)
         {
-            VkDescriptorImageInfo imageInfo = m_textureDescriptors[tex_i].data->getDescriptorInfo();
-
-            size_t binding = m_bufferBundleDescriptors.size() + tex_i;
-            VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-            samplerLayoutBinding.binding = binding;
-            samplerLayoutBinding.descriptorCount = 1;
-            samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            samplerLayoutBinding.pImmutableSamplers = nullptr;
-            samplerLayoutBinding.stageFlags = m_textureDescriptors[tex_i].shaderStageFlags;
-            bindings.push_back(samplerLayoutBinding);
+            if (binding.descriptorCount != 1)
+            {
+                throw std::runtime_error("failed to match material resources, descriptor arrays are not supported!");
+            }
         }
+        std::vector<bool> matched(m_reflection.bindings.size(), false);
+        assignBindings(m_reflection, m_bufferBundleDescriptors, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, matched);
+        assignBindings(m_reflection, m_textureDescriptors, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, matched);
+        assignBindings(m_reflection, m_storageImageDescriptors, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, matched);
+        assignBindings(m_reflection, m_storageBufferBundleDescriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, matched);
 
-        for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
+        for (size_t i = 0; i < matched.size(); i++)
         {
-            VkDescriptorImageInfo imageInfo = m_storageImageDescriptors[tex_i].data->getDescriptorInfo(VK_IMAGE_LAYOUT_GENERAL);
-
-            size_t binding = m_bufferBundleDescriptors.size() + m_textureDescriptors.size() + tex_i;
-            VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-            samplerLayoutBinding.binding = binding;
-            samplerLayoutBinding.descriptorCount = 1;
-            samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-            samplerLayoutBinding.pImmutableSamplers = nullptr;
-            samplerLayoutBinding.stageFlags = m_storageImageDescriptors[tex_i].shaderStageFlags;
-            bindings.push_back(samplerLayoutBinding);
+            if (!matched[i])
+            {
+                const ReflectedBinding &binding = m_reflection.bindings[i];
+                throw std::runtime_error("failed to match material resources, the material has nothing for " + binding.name + " at set " +
+                                         std::to_string(binding.set) + ", binding " + std::to_string(binding.binding) + "!");
+            }
         }
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-        layoutInfo.pBindings = bindings.data();
-
-        if (vkCreateDescriptorSetLayout(VulkanGlobal::context.device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+        // Sets the shader skips get an empty layout, pipeline layouts can't have holes.
+        m_descriptorSetLayouts.clear();
+        for (uint32_t set = 0; set < m_reflection.getSetCount(); set++)
         {
-            throw std::runtime_error("failed to create descriptor set layout!");
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            for (const ReflectedBinding &reflected : m_reflection.bindings)
+            {
+                if (reflected.set != set)
+                {
+                    continue;
+                }
+                VkDescriptorSetLayoutBinding binding{};
+                binding.binding = reflected.binding;
+                binding.descriptorType = reflected.descriptorType;
+                binding.descriptorCount = reflected.descriptorCount;
+                binding.stageFlags = reflected.stageFlags;
+                binding.pImmutableSamplers = nullptr;
+                bindings.push_back(binding);
+            }
+            m_descriptorSetLayouts.push_back(VulkanGlobal::layoutCache.getDescriptorSetLayout(bindings));
         }
     }
 
-    void Material::__initDescriptorPool()
+    void Material::__initPipelineLayout()
     {
-        std::vector<VkDescriptorPoolSize> poolSizes{};
-
-        for (size_t buffer_i = 0; buffer_i < m_bufferBundleDescriptors.size(); buffer_i++)
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        if (m_reflection.pushConstantSize > 0)
         {
-            VkDescriptorPoolSize size;
-            size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            size.descriptorCount = static_cast<uint32_t>(m_descriptorSetsSize);
-            poolSizes.push_back(size);
+            VkPushConstantRange range{};
+            range.stageFlags = m_reflection.pushConstantStageFlags;
+            range.offset = 0;
+            range.size = m_reflection.pushConstantSize;
+            pushConstantRanges.push_back(range);
         }
+        m_pipelineLayout = VulkanGlobal::layoutCache.getPipelineLayout(m_descriptorSetLayouts, pushConstantRanges);
+    }
 
-        for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
+    void Material::__initDescriptorPool()
+    {
+        if (m_descriptorSetLayouts.empty())
         {
-            VkDescriptorPoolSize size;
-            size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            size.descriptorCount = static_cast<uint32_t>(m_descriptorSetsSize);
-            poolSizes.push_back(size);
+            return;
         }
 
-        for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
+        std::vector<VkDescriptorPoolSize> poolSizes{};
+        for (const ReflectedBinding &binding : m_reflection.bindings)
         {
             VkDescriptorPoolSize size;
-            size.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-            size.descriptorCount = static_cast<uint32_t>(m_descriptorSetsSize);
+            size.type = binding.descriptorType;
+            size.descriptorCount = binding.descriptorCount * static_cast<uint32_t>(m_descriptorSetsSize);
             poolSizes.push_back(size);
         }
 
@@ -332,7 +383,7 @@ namespace mcvkp
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(m_descriptorSetsSize);
+        poolInfo.maxSets = static_cast<uint32_t>(m_descriptorSetsSize * m_descriptorSetLayouts.size());
 
         if (vkCreateDescriptorPool(VulkanGlobal::context.device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
         {
@@ -342,26 +393,34 @@ namespace mcvkp
 
     void Material::__initDescriptorSets()
     {
-        std::vector<VkDescriptorSetLayout> layouts(m_descriptorSetsSize, m_descriptorSetLayout);
+        size_t setCount = m_descriptorSetLayouts.size();
+        if (setCount == 0)
+        {
+            return;
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts;
+        for (size_t i = 0; i < m_descriptorSetsSize; i++)
+        {
+            layouts.insert(layouts.end(), m_descriptorSetLayouts.begin(), m_descriptorSetLayouts.end());
+        }
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = m_descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(m_descriptorSetsSize);
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
         allocInfo.pSetLayouts = layouts.data();
 
-        m_descriptorSets.resize(m_descriptorSetsSize);
+        m_descriptorSets.resize(layouts.size());
         if (vkAllocateDescriptorSets(VulkanGlobal::context.device, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to allocate descriptor sets!");
         }
 
-        size_t numDescriptors = m_bufferBundleDescriptors.size() + m_textureDescriptors.size() + m_storageImageDescriptors.size();
+        size_t numDescriptors = m_reflection.bindings.size();
 
         for (size_t i = 0; i < m_descriptorSetsSize; i++)
         {
-            // VkDescriptorBufferInfo bufferInfo = uniformBuffers[i].getDescriptorInfo();
-            // VkDescriptorImageInfo imageInfo = textureImage.getDescriptorInfo();
-            // VkDescriptorBufferInfo sharedBufferInfo = (*sharedUniformBuffers)[i].getDescriptorInfo();
+            const VkDescriptorSet *frameSets = &m_descriptorSets[i * setCount];
 
             std::vector<VkWriteDescriptorSet> descriptorWrites;
             descriptorWrites.reserve(numDescriptors);
@@ -375,8 +434,8 @@ namespace mcvkp
             {
                 VkWriteDescriptorSet descriptorSet{};
                 descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorSet.dstSet = m_descriptorSets[i];
-                descriptorSet.dstBinding = buffer_i;
+                descriptorSet.dstSet = frameSets[m_bufferBundleDescriptors[buffer_i].set];
+                descriptorSet.dstBinding = m_bufferBundleDescriptors[buffer_i].binding;
                 descriptorSet.dstArrayElement = 0;
                 descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
                 descriptorSet.descriptorCount = 1;
@@ -387,16 +446,15 @@ namespace mcvkp
             std::vector<VkDescriptorImageInfo> imageInfos;
             for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
             {
-                imageInfos.push_back(m_textureDescriptors[tex_i].data->getDescriptorInfo());
+                imageInfos.push_back(m_textureDescriptors[tex_i].data->textures[i]->getDescriptorInfo());
             }
 
             for (size_t tex_i = 0; tex_i < m_textureDescriptors.size(); tex_i++)
             {
-                size_t binding = m_bufferBundleDescriptors.size() + tex_i;
                 VkWriteDescriptorSet descriptorSet{};
                 descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorSet.dstSet = m_descriptorSets[i];
-                descriptorSet.dstBinding = binding;
+                descriptorSet.dstSet = frameSets[m_textureDescriptors[tex_i].set];
+                descriptorSet.dstBinding = m_textureDescriptors[tex_i].binding;
                 descriptorSet.dstArrayElement = 0;
                 descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
                 descriptorSet.descriptorCount = 1;
@@ -408,16 +466,15 @@ namespace mcvkp
             std::vector<VkDescriptorImageInfo> storageImageInfos;
             for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
             {
-                storageImageInfos.push_back(m_storageImageDescriptors[tex_i].data->getDescriptorInfo(VK_IMAGE_LAYOUT_GENERAL));
+                storageImageInfos.push_back(m_storageImageDescriptors[tex_i].data->images[i]->getDescriptorInfo(VK_IMAGE_LAYOUT_GENERAL));
             }
 
             for (size_t tex_i = 0; tex_i < m_storageImageDescriptors.size(); tex_i++)
             {
-                size_t binding = m_bufferBundleDescriptors.size() + m_textureDescriptors.size() + tex_i;
                 VkWriteDescriptorSet descriptorSet{};
                 descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorSet.dstSet = m_descriptorSets[i];
-                descriptorSet.dstBinding = binding;
+                descriptorSet.dstSet = frameSets[m_storageImageDescriptors[tex_i].set];
+                descriptorSet.dstBinding = m_storageImageDescriptors[tex_i].binding;
                 descriptorSet.dstArrayElement = 0;
                 descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
                 descriptorSet.descriptorCount = 1;
@@ -426,14 +483,58 @@ namespace mcvkp
                 descriptorWrites.push_back(descriptorSet);
             }
 
+            std::vector<VkDescriptorBufferInfo> storageBufferInfos;
+            for (size_t buffer_i = 0; buffer_i < m_storageBufferBundleDescriptors.size(); buffer_i++)
+            {
+                VkDescriptorBufferInfo bufferInfo = m_storageBufferBundleDescriptors[buffer_i].data->buffers[i]->getDescriptorInfo();
+                // Storage buffers hold arrays, size only describes one element.
+                bufferInfo.range = VK_WHOLE_SIZE;
+                storageBufferInfos.push_back(bufferInfo);
+            }
+
+            for (size_t buffer_i = 0; buffer_i < m_storageBufferBundleDescriptors.size(); buffer_i++)
+            {
+                VkWriteDescriptorSet descriptorSet{};
+                descriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorSet.dstSet = frameSets[m_storageBufferBundleDescriptors[buffer_i].set];
+                descriptorSet.dstBinding = m_storageBufferBundleDescriptors[buffer_i].binding;
+                descriptorSet.dstArrayElement = 0;
+                descriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorSet.descriptorCount = 1;
+                descriptorSet.pBufferInfo = &storageBufferInfos[buffer_i];
+
+                descriptorWrites.push_back(descriptorSet);
+            }
+
             vkUpdateDescriptorSets(VulkanGlobal::context.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
         }
     }
 
     void Material::bind(VkCommandBuffer &commandBuffer, size_t currentFrame)
     {
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[currentFrame], 0, nullptr);
+        if (!m_descriptorSetLayouts.empty())
+        {
+            uint32_t setCount = static_cast<uint32_t>(m_descriptorSetLayouts.size());
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, setCount, &m_descriptorSets[currentFrame * setCount], 0, nullptr);
+        }
 
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+        __pushConstantBlock(commandBuffer);
+    }
+
+    void Material::__pushConstantBlock(VkCommandBuffer commandBuffer)
+    {
+        if (!m_pushConstants || m_pushConstants->getData().empty())
+        {
+            return;
+        }
+        const std::vector<uint8_t> &data = m_pushConstants->getData();
+        if (m_pushConstantOffset + data.size() > m_reflection.pushConstantSize)
+        {
+            throw std::runtime_error("push constants don't fit the shader's push constant block!");
+        }
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, m_reflection.pushConstantStageFlags,
+                           m_pushConstantOffset, static_cast<uint32_t>(data.size()), data.data());
     }
 }
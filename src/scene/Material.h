@@ -1,10 +1,14 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <cstring>
+#include <string>
 #include "../memory/Buffer.h"
 #include "../utils/vulkan.h"
 #include "../memory/Image.h"
 #include "../app-context/VulkanSwapchain.h"
+#include "../render-context/LayoutCache.h"
+#include "../render-context/ShaderReflection.h"
 
 namespace mcvkp
 {
@@ -13,6 +17,31 @@ namespace mcvkp
     {
         std::shared_ptr<T> data;
         VkShaderStageFlags shaderStageFlags;
+        // Name of the shader's binding it is bound to, see ReflectedBinding::name.
+        std::string name;
+        // Where the shader declares it, filled in by init.
+        uint32_t set = 0;
+        uint32_t binding = 0;
+    };
+
+    // Small parameters pushed with vkCmdPushConstants instead of going through a uniform buffer.
+    // One block can be shared by several materials, each pushes what it holds when its commands are
+    // recorded, so command buffers using it are recorded again whenever it changes.
+    class PushConstantBlock
+    {
+    public:
+        template <typename T>
+        void set(const T &value)
+        {
+            static_assert(sizeof(T) % 4 == 0, "push constants are pushed in 4 byte units");
+            m_data.resize(sizeof(T));
+            memcpy(m_data.data(), &value, sizeof(T));
+        }
+
+        const std::vector<uint8_t> &getData() const { return m_data; }
+
+    private:
+        std::vector<uint8_t> m_data;
     };
 
     class Material
@@ -26,17 +55,36 @@ namespace mcvkp
 
         ~Material();
 
-        void addTexture(const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags);
+        // Resources are matched by name to the bindings the shaders declare, the name of the variable or
+        // of a block without an instance name. init throws when a name is missing, declared with another
+        // descriptor type or left without a resource. Binding stages come from the shaders too,
+        // shaderStageFlags only documents the intent.
+
+        // Single resources are shared by all descriptor sets.
+        void addTexture(const std::string &name, const std::shared_ptr<Texture> &texture, VkShaderStageFlags shaderStageFlags);
+
+        void addStorageImage(const std::string &name, const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags);
 
-        void addStorageImage(const std::shared_ptr<Image> &image, VkShaderStageFlags shaderStageFlags);
+        // Descriptor set i references the bundle's i-th texture or image.
+        void addTextureBundle(const std::string &name, const std::shared_ptr<TextureBundle> &textureBundle, VkShaderStageFlags shaderStageFlags);
 
-        void addBufferBundle(const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+        void addStorageImageBundle(const std::string &name, const std::shared_ptr<ImageBundle> &imageBundle, VkShaderStageFlags shaderStageFlags);
+
+        void addBufferBundle(const std::string &name, const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+
+        // Storage buffers cover the whole buffer.
+        void addStorageBufferBundle(const std::string &name, const std::shared_ptr<BufferBundle> &bufferBundle, VkShaderStageFlags shaderStageFlags);
+
+        // Pushed at offset whenever the material is bound, the shaders' push constant block must cover it.
+        void setPushConstants(const std::shared_ptr<PushConstantBlock> &pushConstants, uint32_t offset = 0);
 
         const std::vector<Descriptor<BufferBundle> > &getBufferBundles() const;
 
-        const std::vector<Descriptor<Texture> > &getTextures() const;
+        const std::vector<Descriptor<TextureBundle> > &getTextures() const;
 
-        const std::vector<Descriptor<Image> > &getStorageImages() const;
+        const std::vector<Descriptor<ImageBundle> > &getStorageImages() const;
+
+        const std::vector<Descriptor<BufferBundle> > &getStorageBufferBundles() const;
 
         // Initialize material when adding to a scene.
         void init(const VkRenderPass &renderPass);
@@ -44,20 +92,27 @@ namespace mcvkp
         void bind(VkCommandBuffer &commandBuffer, size_t currentFrame);
 
     protected:
-        void __initDescriptorSetLayout();
+        // Layouts come from VulkanGlobal::layoutCache, built from m_reflection.
+        void __initDescriptorSetLayouts();
+        void __initPipelineLayout();
         void __initDescriptorPool();
         void __initDescriptorSets();
         void __initPipeline(
             const VkExtent2D &swapChainExtent,
             const VkRenderPass &renderPass,
-            std::string vertexShaderPath,
-            std::string fragmentShaderPath);
+            const std::vector<char> &vertShaderCode,
+            const std::vector<char> &fragShaderCode);
         VkShaderModule __createShaderModule(const std::vector<char> &code);
+        void __pushConstantBlock(VkCommandBuffer commandBuffer);
 
     protected:
         std::vector<Descriptor<BufferBundle> > m_bufferBundleDescriptors;
-        std::vector<Descriptor<Texture> > m_textureDescriptors;
-        std::vector<Descriptor<Image> > m_storageImageDescriptors;
+        std::vector<Descriptor<TextureBundle> > m_textureDescriptors;
+        std::vector<Descriptor<ImageBundle> > m_storageImageDescriptors;
+        std::vector<Descriptor<BufferBundle> > m_storageBufferBundleDescriptors;
+
+        std::shared_ptr<PushConstantBlock> m_pushConstants;
+        uint32_t m_pushConstantOffset = 0;
 
         std::string m_vertexShaderPath;
         std::string m_fragmentShaderPath;
@@ -66,11 +121,14 @@ namespace mcvkp
 
         uint32_t m_descriptorSetsSize;
 
-        VkPipelineLayout m_pipelineLayout;
-        VkPipeline m_pipeline;
+        ShaderReflection m_reflection;
+
+        VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
 
-        VkDescriptorPool m_descriptorPool;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        // Every set of the layout for each swapchain image, set s of image i at i * set count + s.
         std::vector<VkDescriptorSet> m_descriptorSets;
-        VkDescriptorSetLayout m_descriptorSetLayout;
+        std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
     };
 }
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include "Scene.h"
 
 namespace mcvkp
 {
+    // Fewer draws than this per thread are recorded faster inline than handed to the recorder.
+    static const size_t MIN_MODELS_PER_SLICE = 256;
+
     Scene::Scene(RenderPassType RenderPassType)
     {
         switch (RenderPassType)
@@ -38,7 +42,7 @@ namespace mcvkp
         return m_RenderPass;
     }
 
-    void Scene::writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame)
+    void Scene::writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelRecorder *recorder)
     {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -53,13 +57,43 @@ namespace mcvkp
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        size_t sliceCount = recorder ? std::min(recorder->getThreadCount(), m_models.size() / MIN_MODELS_PER_SLICE) : 0;
+        if (sliceCount < 2)
+        {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            for (std::shared_ptr<DrawableModel> model : m_models)
+            {
+                model->drawCommand(commandBuffer, currentFrame);
+            }
 
-        for (std::shared_ptr<DrawableModel> model : m_models)
+            vkCmdEndRenderPass(commandBuffer);
+            return;
+        }
+
+        // Materials set no dynamic state, so the slices only need the pass they draw in.
+        std::vector<ParallelRecorder::RecordFunction> slices;
+        for (size_t slice = 0; slice < sliceCount; slice++)
         {
-            model->drawCommand(commandBuffer, currentFrame);
+            size_t begin = m_models.size() * slice / sliceCount;
+            size_t end = m_models.size() * (slice + 1) / sliceCount;
+            slices.push_back([this, currentFrame, begin, end](VkCommandBuffer sliceCommandBuffer)
+                             {
+                                 for (size_t model = begin; model < end; model++)
+                                 {
+                                     m_models[model]->drawCommand(sliceCommandBuffer, currentFrame);
+                                 }
+                             });
         }
 
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPassInfo.renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = renderPassInfo.framebuffer;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recorder->record(commandBuffer, slices, &inheritance);
         vkCmdEndRenderPass(commandBuffer);
     }
 }
@@ -5,6 +5,7 @@
 #include "../render-context/RenderPass.h"
 #include "../render-context/ForwardRenderPass.h"
 #include "../render-context/FlatRenderPass.h"
+#include "../render-context/ParallelRecorder.h"
 #include "../utils/vulkan.h"
 
 namespace mcvkp
@@ -19,7 +20,8 @@ namespace mcvkp
     {
     public:
         Scene(RenderPassType type);
-        void writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame);
+        // With a recorder, large scenes record slices of their models on its threads.
+        void writeRenderCommand(VkCommandBuffer &commandBuffer, const size_t currentFrame, ParallelRecorder *recorder = nullptr);
         void addModel(std::shared_ptr<DrawableModel> model);
         std::shared_ptr<RenderPass> getRenderPass();
 
@@ -0,0 +1,49 @@
+#include <stdexcept>
+
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+FileWatcher::FileWatcher(const std::string &directory) {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("failed to initialize inotify!");
+    }
+    // Editors that save through a temporary file and a rename only show up as moves.
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        throw std::runtime_error("failed to watch " + directory + "!");
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    close(fd);
+}
+
+bool FileWatcher::poll() {
+    // An editor saving once can raise several events, they all count as one change.
+    bool changed = false;
+    alignas(inotify_event) char events[4096];
+    ssize_t length;
+    while ((length = read(fd, events, sizeof(events))) > 0) {
+        changed = true;
+    }
+    if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        throw std::runtime_error("failed to read file events!");
+    }
+    return changed;
+}
+#else
+FileWatcher::FileWatcher(const std::string &directory) : fd(-1) {
+    throw std::runtime_error("watching " + directory + " needs inotify, which this platform doesn't have!");
+}
+
+FileWatcher::~FileWatcher() {}
+
+bool FileWatcher::poll() {
+    return false;
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+// Watches a directory for files that were written or moved into it, with inotify.
+// Never blocks, changes are collected by polling once per frame.
+class FileWatcher {
+    public:
+        FileWatcher(const std::string &directory);
+
+        ~FileWatcher();
+
+        // True when a file in the directory changed since the last call.
+        bool poll();
+
+    private:
+        int fd;
+};
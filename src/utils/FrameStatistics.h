@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Collects per-frame samples and summarizes them for benchmark reports.
+class FrameStatistics {
+    public:
+        void add(double sample) { samples.push_back(sample); }
+
+        size_t size() const { return samples.size(); }
+
+        bool empty() const { return samples.empty(); }
+
+        // Nearest-rank percentile, p in [0, 100].
+        double percentile(double p) const {
+            std::vector<double> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+            rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+            return sorted[rank - 1];
+        }
+
+        double mean() const {
+            double sum = 0;
+            for (double sample : samples) {
+                sum += sample;
+            }
+            return sum / samples.size();
+        }
+
+        // Writes {"min": .., "p50": .., "p95": .., "p99": .., "max": .., "mean": ..}, or null without samples.
+        void writeJson(std::ostream &out) const {
+            if (samples.empty()) {
+                out << "null";
+                return;
+            }
+            out << "{\"min\": " << percentile(0)
+                << ", \"p50\": " << percentile(50)
+                << ", \"p95\": " << percentile(95)
+                << ", \"p99\": " << percentile(99)
+                << ", \"max\": " << percentile(100)
+                << ", \"mean\": " << mean() << "}";
+        }
+
+    private:
+        std::vector<double> samples;
+};
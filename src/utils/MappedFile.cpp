@@ -0,0 +1,28 @@
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string &path, uint64_t size) : size(size) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open output file!");
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        throw std::runtime_error("failed to resize output file!");
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("failed to map output file!");
+    }
+    data = static_cast<uint8_t*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+    munmap(data, size);
+    close(fd);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// A file mapped into memory for writing. The file is created or truncated to the given size,
+// so regions that are never written stay sparse on disk.
+class MappedFile {
+    public:
+        uint8_t* data;
+        uint64_t size;
+
+        MappedFile(const std::string &path, uint64_t size);
+
+        ~MappedFile();
+
+    private:
+        int fd;
+};